@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>  // size_t
+#include <type_traits>
+#include <utility>
+
+// Empty non-final members are stored as base classes, so stateless deleters,
+// allocators and policies take no space. The index in `CompressedTupleElement`
+// keeps bases distinct, so repeated empty types work too (they just can't share an address).
+template <size_t I, typename T, bool = std::is_empty_v<T> && !std::is_final_v<T>>
+class CompressedTupleElement;
+
+template <size_t I, typename T>
+class CompressedTupleElement<I, T, false> {
+public:
+    CompressedTupleElement() : value_(){};
+
+    template <typename Arg>
+    explicit CompressedTupleElement(Arg&& arg) : value_(std::forward<Arg>(arg)){};
+
+    T& Get() {
+        return value_;
+    }
+    const T& Get() const {
+        return value_;
+    }
+
+private:
+    T value_;
+};
+
+template <size_t I, typename T>
+class CompressedTupleElement<I, T, true> : private T {
+public:
+    CompressedTupleElement() : T(){};
+
+    template <typename Arg>
+    explicit CompressedTupleElement(Arg&& arg) : T(std::forward<Arg>(arg)){};
+
+    T& Get() {
+        return static_cast<T&>(*this);
+    }
+    const T& Get() const {
+        return static_cast<const T&>(*this);
+    }
+};
+
+// The `I`-th type of `Ts...`
+template <size_t I, typename T, typename... Ts>
+struct TypeAt {
+    using Type = typename TypeAt<I - 1, Ts...>::Type;
+};
+
+template <typename T, typename... Ts>
+struct TypeAt<0, T, Ts...> {
+    using Type = T;
+};
+
+template <size_t I, typename... Ts>
+using TypeAtT = typename TypeAt<I, Ts...>::Type;
+
+template <typename Indices, typename... Ts>
+class CompressedTupleImpl;
+
+template <size_t... Is, typename... Ts>
+class CompressedTupleImpl<std::index_sequence<Is...>, Ts...> : private CompressedTupleElement<Is, Ts>... {
+public:
+    CompressedTupleImpl() = default;
+
+    template <typename... Args>
+    explicit CompressedTupleImpl(Args&&... args)
+        : CompressedTupleElement<Is, Ts>(std::forward<Args>(args))...{};
+
+    template <size_t I>
+    TypeAtT<I, Ts...>& Get() {
+        return static_cast<CompressedTupleElement<I, TypeAtT<I, Ts...>>&>(*this).Get();
+    }
+
+    template <size_t I>
+    const TypeAtT<I, Ts...>& Get() const {
+        return static_cast<const CompressedTupleElement<I, TypeAtT<I, Ts...>>&>(*this).Get();
+    }
+};
+
+// A tuple that takes no space for empty members, e.g.
+// `CompressedTuple<T*, Deleter, Allocator>` is as big as `T*` for stateless policies.
+template <typename... Ts>
+class CompressedTuple : public CompressedTupleImpl<std::index_sequence_for<Ts...>, Ts...> {
+    using Impl = CompressedTupleImpl<std::index_sequence_for<Ts...>, Ts...>;
+
+public:
+    CompressedTuple() = default;
+
+    // One argument per element
+    template <typename... Args>
+        requires(sizeof...(Args) == sizeof...(Ts) && sizeof...(Ts) > 0 &&
+                 !(sizeof...(Args) == 1 &&
+                   (std::is_same_v<std::remove_cvref_t<Args>, CompressedTuple> && ...)))
+    explicit CompressedTuple(Args&&... args) : Impl(std::forward<Args>(args)...){};
+};
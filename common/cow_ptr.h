@@ -0,0 +1,76 @@
+#pragma once
+
+// Include after the directory's `shared.h`, it provides `DefaultSharedPolicy`.
+
+#include <common/shared_core.h>
+
+#include <cstddef>  // size_t
+#include <type_traits>
+#include <utility>
+
+// Copy-on-write value: copies share one `T`, and `Write()` clones it first unless this
+// is the only copy. Cheap to pass by value instead of deep-copying defensively.
+//
+// The unique check is `UseCount() == 1`. It is exact here because the `SharedPtr`
+// never leaves the wrapper, so nothing but another `CowPtr` can add an owner, and that
+// needs a copy of this one. With `MultiThreaded` counters the load is acquire and the
+// other owners' decrements are release, so their reads finish before the write starts.
+// A single `CowPtr` object must not be written and copied concurrently, like any value.
+template <typename T, typename Policy = DefaultSharedPolicy>
+class CowPtr {
+    static_assert(!std::is_convertible_v<T*, EnableSharedFromThisBase*>,
+                  "SharedFromThis would add owners behind the unique check");
+
+public:
+    CowPtr() : value_(MakeShared<T, Policy>()) {
+    }
+
+    template <typename... Args>
+    explicit CowPtr(std::in_place_t, Args&&... args)
+        : value_(MakeShared<T, Policy>(std::forward<Args>(args)...)) {
+    }
+
+    // Copies share; a moved-from `CowPtr` may only be assigned to or destroyed
+    CowPtr(const CowPtr&) = default;
+    CowPtr(CowPtr&&) noexcept = default;
+    CowPtr& operator=(const CowPtr&) = default;
+    CowPtr& operator=(CowPtr&&) noexcept = default;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Access
+
+    const T& operator*() const {
+        return *value_;
+    }
+    const T* operator->() const {
+        return value_.Get();
+    }
+    const T& Read() const {
+        return *value_;
+    }
+
+    // The reference is valid until this `CowPtr` is copied or assigned
+    T& Write() {
+        if (!Unique()) {
+            value_ = MakeShared<T, Policy>(std::as_const(*value_));
+        }
+        return *value_;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    bool Unique() const {
+        return value_.UseCount() == 1;
+    }
+    size_t UseCount() const {
+        return value_.UseCount();
+    }
+
+    void Swap(CowPtr& other) noexcept {
+        value_.Swap(other.value_);
+    }
+
+private:
+    SharedPtr<T, Policy> value_;
+};
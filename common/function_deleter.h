@@ -0,0 +1,18 @@
+#pragma once
+
+// Deleter that calls `Fn` known at compile time, e.g. `FunctionDeleter<&fclose>`.
+// Unlike a function pointer it is empty, so it takes no space in `UniquePtr`
+// or a `SharedPtr` control block, and the call can be inlined.
+// Also fits `RefCounted` as its `Deleter` parameter.
+template <auto Fn>
+struct FunctionDeleter {
+    template <typename T>
+    void operator()(T* ptr) const {
+        Fn(ptr);
+    }
+
+    template <typename T>
+    static void Destroy(T* object) {
+        Fn(object);
+    }
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+// Include after the directory's `weak.h`, it provides `DefaultSharedPolicy`.
+
+#include <common/weak_core.h>
+
+#include <cstddef>     // size_t
+#include <functional>  // std::hash, std::equal_to
+#include <new>         // std::launder
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+// Canonical immutable value handed out by `Interner`: equal values share one object,
+// so they can be compared by `Get()`.
+template <typename T, typename Policy = DefaultSharedPolicy>
+using HashConsed = SharedPtr<const T, Policy>;
+
+// Hash-consing table: `Intern(value)` returns the live canonical copy of `value`
+// or creates it. The table only holds `WeakPtr`s; an entry is purged by its control
+// block when the last `SharedPtr` goes away, so nothing ever scans for expired entries.
+// Values may outlive the interner. Single-threaded only.
+template <typename T, typename Hash = std::hash<T>, typename Equal = std::equal_to<T>,
+          typename Policy = DefaultSharedPolicy>
+class Interner {
+    static_assert(Policy::kWeakSupport, "Entries are WeakPtr");
+    static_assert(std::is_same_v<typename Policy::Counter, SingleThreaded::Counter>,
+                  "Entries are purged without synchronization");
+
+public:
+    Interner() = default;
+
+    Interner(const Interner&) = delete;
+    Interner& operator=(const Interner&) = delete;
+
+    // Surviving values stop reporting back
+    ~Interner() {
+        for (auto& [hash, entry] : entries_) {
+            entry.block->interner_ = nullptr;
+        }
+    }
+
+    template <typename V>
+    HashConsed<T, Policy> Intern(V&& value) {
+        size_t hash = Hash()(value);
+        auto [begin, end] = entries_.equal_range(hash);
+        for (auto it = begin; it != end; ++it) {
+            if (Equal()(*it->second.block->GetObjectPtr(), value)) {
+                return it->second.weak.Lock();
+            }
+        }
+
+        HashConsed<T, Policy> return_ptr;
+        Block* block = new Block(this, hash, std::forward<V>(value));
+        return_ptr.SetObservedPtr(block->GetObjectPtr());
+        return_ptr.SetBlockPtr(block);
+        entries_.emplace(hash, Entry{WeakPtr<const T, Policy>(return_ptr), block});
+        return return_ptr;
+    }
+
+    // Number of distinct live values
+    size_t Size() const {
+        return entries_.size();
+    }
+
+private:
+    // `MakeShared` block that reports its last strong release before the value dies
+    class Block : public CountingControlBlock<Policy> {
+    public:
+        template <typename... Args>
+        explicit Block(Interner* interner, size_t hash, Args&&... args)
+            : interner_(interner), hash_(hash) {
+            new (&buffer_) T(std::forward<Args>(args)...);
+        }
+
+        T* GetObjectPtr() {
+            return std::launder(reinterpret_cast<T*>(&buffer_));
+        }
+
+    protected:
+        // Purge first: the destructor of `T` may release other values of the same interner
+        void DestroyObject() override {
+            if (interner_) {
+                interner_->Purge(this);
+            }
+            GetObjectPtr()->~T();
+        }
+
+    private:
+        friend class Interner;
+
+        Interner* interner_;
+        size_t hash_;
+        std::aligned_storage_t<sizeof(T), alignof(T)> buffer_;
+    };
+
+    struct Entry {
+        WeakPtr<const T, Policy> weak;
+        Block* block;
+    };
+
+    void Purge(Block* block) {
+        auto [begin, end] = entries_.equal_range(block->hash_);
+        for (auto it = begin; it != end; ++it) {
+            if (it->second.block == block) {
+                entries_.erase(it);
+                return;
+            }
+        }
+    }
+
+    std::unordered_multimap<size_t, Entry> entries_;
+};
@@ -0,0 +1,241 @@
+#pragma once
+
+// Include after the directory's `shared.h`, it provides `DefaultSharedPolicy`.
+
+#include <common/shared_core.h>
+
+#include <fcntl.h>     // open
+#include <sys/mman.h>  // mmap, munmap, madvise
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // close, sysconf
+
+#include <algorithm>  // std::min
+#include <cerrno>
+#include <cstddef>  // size_t
+#include <cstdint>  // std::uintptr_t
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+// Read-only piece of a mapped file. Every slice holds the mapping it points into,
+// so it stays readable after the `MappedFile` and the other slices are gone.
+template <typename Policy = DefaultSharedPolicy>
+class BasicMappedSlice {
+public:
+    BasicMappedSlice() = default;
+
+    // Bytes `[offset, offset + length)` of this slice, sharing the mapping
+    BasicMappedSlice Slice(size_t offset, size_t length) const& {
+        return BasicMappedSlice(SharedPtr<const char, Policy>(data_, data_.Get() + offset), length);
+    }
+    BasicMappedSlice Slice(size_t offset, size_t length) && {
+        const char* data = data_.Get() + offset;
+        return BasicMappedSlice(SharedPtr<const char, Policy>(std::move(data_), data), length);
+    }
+
+    const char* Data() const {
+        return data_.Get();
+    }
+    size_t Size() const {
+        return size_;
+    }
+    bool Empty() const {
+        return size_ == 0;
+    }
+    std::span<const char> Span() const {
+        return std::span<const char>(data_.Get(), size_);
+    }
+    std::string_view View() const {
+        return std::string_view(data_.Get(), size_);
+    }
+
+    // Slices sharing the mapping
+    size_t UseCount() const {
+        return data_.UseCount();
+    }
+
+private:
+    template <typename P>
+    friend class BasicMappedFile;
+
+    BasicMappedSlice(SharedPtr<const char, Policy> data, size_t size)
+        : data_(std::move(data)), size_(size) {
+    }
+
+    SharedPtr<const char, Policy> data_;
+    size_t size_ = 0;
+};
+
+enum class MappedFileAdvice { kNormal, kSequential, kRandom, kWillNeed };
+
+struct MappedFileOptions {
+    // `madvise` hint for every mapping
+    MappedFileAdvice advice = MappedFileAdvice::kNormal;
+    // Place mappings on 2 MiB boundaries and ask for transparent huge pages
+    bool huge_page_aligned = false;
+    // Map each `Slice` on its own instead of the whole file at once,
+    // for files larger than the address space one is willing to spend
+    bool streaming = false;
+};
+
+// `mmap`s a file for zero-copy reading. The mapping belongs to one control block whose
+// deleter `munmap`s it; slices are aliasing `SharedPtr`s into it. OS errors are thrown
+// as `std::system_error`.
+template <typename Policy = DefaultSharedPolicy>
+class BasicMappedFile {
+public:
+    explicit BasicMappedFile(const std::string& path, MappedFileOptions options = {})
+        : options_(options) {
+        fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+        try {
+            struct stat info;
+            if (fstat(fd_, &info) != 0) {
+                throw std::system_error(errno, std::generic_category(), "fstat " + path);
+            }
+            size_ = static_cast<size_t>(info.st_size);
+            if (!options_.streaming) {
+                whole_ = Map(0, size_);
+                close(std::exchange(fd_, -1));
+            }
+        } catch (...) {
+            close(fd_);
+            throw;
+        }
+    }
+
+    BasicMappedFile(const BasicMappedFile&) = delete;
+    BasicMappedFile& operator=(const BasicMappedFile&) = delete;
+
+    BasicMappedFile(BasicMappedFile&& other) noexcept
+        : whole_(std::move(other.whole_)),
+          options_(other.options_),
+          size_(other.size_),
+          fd_(std::exchange(other.fd_, -1)) {
+    }
+
+    ~BasicMappedFile() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Slices
+
+    // In streaming mode this maps `[offset, offset + length)` (widened to pages) right now
+    BasicMappedSlice<Policy> Slice(size_t offset, size_t length) const {
+        if (!options_.streaming) {
+            return whole_.Slice(offset, length);
+        }
+        return Map(offset, length);
+    }
+
+    BasicMappedSlice<Policy> All() const {
+        return Slice(0, size_);
+    }
+
+    // `fn(offset, slice)` for consecutive pieces of `window` bytes. In streaming mode
+    // only the windows still referenced by the caller stay mapped.
+    template <typename Fn>
+    void ForEachWindow(size_t window, Fn&& fn) const {
+        for (size_t offset = 0; offset < size_; offset += window) {
+            fn(offset, Slice(offset, std::min(window, size_ - offset)));
+        }
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+private:
+    static constexpr size_t kHugePageSize = size_t{2} << 20;
+
+    struct Unmap {
+        void operator()(const char* base) const {
+            munmap(const_cast<char*>(base), length);
+        }
+
+        size_t length;
+    };
+
+    BasicMappedSlice<Policy> Map(size_t offset, size_t length) const {
+        if (length == 0) {
+            return BasicMappedSlice<Policy>();
+        }
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t begin = offset / page * page;
+        size_t mapped_length = offset + length - begin;
+        void* base = options_.huge_page_aligned
+                         ? MapAligned(begin, mapped_length, page)
+                         : mmap(nullptr, mapped_length, PROT_READ, MAP_PRIVATE, fd_, begin);
+        if (base == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "mmap");
+        }
+        Advise(base, mapped_length);
+
+        // Unmaps by itself if the control block can't be allocated
+        SharedPtr<const char, Policy> mapping(static_cast<const char*>(base), Unmap{mapped_length});
+        const char* data = static_cast<const char*>(base) + (offset - begin);
+        return BasicMappedSlice<Policy>(SharedPtr<const char, Policy>(std::move(mapping), data), length);
+    }
+
+    // Reserves a larger range, maps the file over its aligned part and trims the rest
+    void* MapAligned(size_t begin, size_t length, size_t page) const {
+        length = (length + page - 1) / page * page;
+        size_t reserved = length + kHugePageSize;
+        void* raw = mmap(nullptr, reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            return MAP_FAILED;
+        }
+        char* reservation = static_cast<char*>(raw);
+        uintptr_t address = reinterpret_cast<uintptr_t>(reservation);
+        char* aligned = reservation + ((kHugePageSize - address % kHugePageSize) % kHugePageSize);
+        if (mmap(aligned, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd_, begin) == MAP_FAILED) {
+            int error = errno;
+            munmap(reservation, reserved);
+            errno = error;
+            return MAP_FAILED;
+        }
+        if (aligned != reservation) {
+            munmap(reservation, aligned - reservation);
+        }
+        char* end = aligned + length;
+        if (end != reservation + reserved) {
+            munmap(end, reservation + reserved - end);
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+        return aligned;
+    }
+
+    // Hints only, failures are ignored
+    void Advise(void* base, size_t length) const {
+        switch (options_.advice) {
+            case MappedFileAdvice::kNormal:
+                break;
+            case MappedFileAdvice::kSequential:
+                madvise(base, length, MADV_SEQUENTIAL);
+                break;
+            case MappedFileAdvice::kRandom:
+                madvise(base, length, MADV_RANDOM);
+                break;
+            case MappedFileAdvice::kWillNeed:
+                madvise(base, length, MADV_WILLNEED);
+                break;
+        }
+    }
+
+    BasicMappedSlice<Policy> whole_;
+    MappedFileOptions options_;
+    size_t size_ = 0;
+    int fd_ = -1;
+};
+
+using MappedSlice = BasicMappedSlice<DefaultSharedPolicy>;
+using MappedFile = BasicMappedFile<DefaultSharedPolicy>;
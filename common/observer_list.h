@@ -0,0 +1,215 @@
+#pragma once
+
+// Include after the directory's `weak.h`, it provides `DefaultSharedPolicy`.
+
+#include <common/weak_core.h>
+
+#include <algorithm>  // std::min
+#include <cstddef>    // size_t
+#include <utility>
+#include <vector>
+
+// Listeners held by `WeakPtr`, e.g. for signal/slot dispatch: the list never keeps
+// a listener alive, and a dead listener is dropped the next time it is seen.
+//
+// Entries are stored as two arrays (control blocks and object pointers), so the lock pass
+// only walks the blocks. `Dispatch` locks listeners a batch at a time, squeezes out dead
+// entries in the same pass and only then calls back, so compaction costs nothing extra.
+// The list itself is single-threaded; listeners may die on any thread if `Policy` allows.
+template <typename T, typename Policy = DefaultSharedPolicy>
+class ObserverList {
+    static_assert(Policy::kWeakSupport, "Listeners are held by WeakPtr");
+
+public:
+    ObserverList() = default;
+
+    ObserverList(const ObserverList&) = delete;
+    ObserverList& operator=(const ObserverList&) = delete;
+
+    ObserverList(ObserverList&&) = default;
+    ObserverList& operator=(ObserverList&& other) {
+        if (this != &other) {
+            Clear();
+            blocks_ = std::move(other.blocks_);
+            objects_ = std::move(other.objects_);
+            live_after_compaction_ = other.live_after_compaction_;
+        }
+        return *this;
+    }
+
+    ~ObserverList() {
+        Clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    // Also allowed from inside `Dispatch`, the new listener is called from the next one on
+    void Add(WeakPtr<T, Policy> listener) {
+        if (!listener.observed_ptr_) {
+            return;
+        }
+        // Without dispatches dead entries would pile up
+        if (!compaction_ && blocks_.size() >= 2 * live_after_compaction_ + 16) {
+            Compact();
+        }
+        blocks_.push_back(listener.base_block_);
+        try {
+            objects_.push_back(listener.observed_ptr_);
+        } catch (...) {
+            blocks_.pop_back();
+            throw;
+        }
+        // The weak reference now belongs to the list
+        listener.base_block_ = EmptyControlBlock();
+        listener.observed_ptr_ = nullptr;
+    }
+
+    // By owner; not from inside `Dispatch`, nor is `Clear` or `Compact`
+    template <typename Listener>
+    bool Remove(const Listener& listener) {
+        for (size_t i = 0; i < blocks_.size(); ++i) {
+            if (blocks_[i] == listener.base_block_) {
+                blocks_[i]->DecreaseWeakCounter();
+                blocks_.erase(blocks_.begin() + i);
+                objects_.erase(objects_.begin() + i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Clear() {
+        for (WeakControlBlock* block : blocks_) {
+            block->DecreaseWeakCounter();
+        }
+        blocks_.clear();
+        objects_.clear();
+        live_after_compaction_ = 0;
+    }
+
+    // Drops dead entries, keeping the order of the rest
+    void Compact() {
+        size_t kept = 0;
+        for (size_t i = 0; i < blocks_.size(); ++i) {
+            if (blocks_[i]->GetStrongCounter() == 0) {
+                blocks_[i]->DecreaseWeakCounter();
+            } else {
+                blocks_[kept] = blocks_[i];
+                objects_[kept] = objects_[i];
+                ++kept;
+            }
+        }
+        blocks_.resize(kept);
+        objects_.resize(kept);
+        live_after_compaction_ = kept;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Dispatch
+
+    // Calls `fn(T&)` for every live listener in the order they were added, returns how many.
+    // A listener is held strongly while its batch is being called back.
+    // A `Dispatch` from inside a callback calls back the same way, but leaves compaction
+    // to the outermost one, which still holds indices into the list.
+    template <typename Fn>
+    size_t Dispatch(Fn&& fn) {
+        if (compaction_) {
+            return DispatchNested(fn);
+        }
+
+        Compaction compaction{this};
+        compaction_ = &compaction;
+
+        size_t end = blocks_.size();
+        size_t called = 0;
+        SharedPtr<T, Policy> batch[kBatchSize];
+        while (compaction.next < end) {
+            size_t batch_end = std::min(end, compaction.next + kBatchSize);
+            size_t locked = 0;
+            for (size_t i = compaction.next; i < batch_end; ++i) {
+                WeakControlBlock* block = blocks_[i];
+                if (block->TryIncreaseStrongCounter()) {
+                    batch[locked].SetBlockPtr(block);
+                    batch[locked].SetObservedPtr(objects_[i]);
+                    ++locked;
+                    blocks_[compaction.kept] = block;
+                    objects_[compaction.kept] = objects_[i];
+                    ++compaction.kept;
+                } else {
+                    block->DecreaseWeakCounter();
+                }
+            }
+            compaction.next = batch_end;
+
+            for (size_t i = 0; i < locked; ++i) {
+                fn(*batch[i]);
+                batch[i].Reset();
+                ++called;
+            }
+        }
+        return called;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    // Including dead listeners not seen since they died
+    size_t Size() const {
+        return blocks_.size();
+    }
+    bool Empty() const {
+        return blocks_.empty();
+    }
+
+private:
+    static constexpr size_t kBatchSize = 32;
+
+    // State of the outermost `Dispatch`: entries before `kept` are live and compacted,
+    // entries from `next` on are not visited yet, the ones in between are stale.
+    // Finishes compaction even if a callback throws.
+    struct Compaction {
+        ~Compaction() {
+            list->compaction_ = nullptr;
+            size_t tail = list->blocks_.size() - next;
+            std::move(list->blocks_.begin() + next, list->blocks_.end(),
+                      list->blocks_.begin() + kept);
+            std::move(list->objects_.begin() + next, list->objects_.end(),
+                      list->objects_.begin() + kept);
+            list->blocks_.resize(kept + tail);
+            list->objects_.resize(kept + tail);
+            list->live_after_compaction_ = kept + tail;
+        }
+
+        ObserverList* list;
+        size_t kept = 0;
+        size_t next = 0;
+    };
+
+    // Skips the stale range of the outer `Dispatch`; dead entries are skipped but kept
+    template <typename Fn>
+    size_t DispatchNested(Fn& fn) {
+        size_t called = 0;
+        auto visit = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (blocks_[i]->TryIncreaseStrongCounter()) {
+                    SharedPtr<T, Policy> listener;
+                    listener.SetBlockPtr(blocks_[i]);
+                    listener.SetObservedPtr(objects_[i]);
+                    fn(*listener);
+                    ++called;
+                }
+            }
+        };
+        size_t next = compaction_->next;
+        size_t end = blocks_.size();
+        visit(0, compaction_->kept);
+        visit(next, end);
+        return called;
+    }
+
+    std::vector<WeakControlBlock*> blocks_;
+    std::vector<T*> objects_;
+    size_t live_after_compaction_ = 0;
+    Compaction* compaction_ = nullptr;
+};
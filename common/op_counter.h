@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>  // size_t
+
+// Test helper: counters that record every refcount operation, so tests can check
+// that a path does no redundant increment / decrement pairs.
+struct RefcountOps {
+    inline static size_t increments = 0;
+    inline static size_t decrements = 0;
+
+    static void Reset() {
+        increments = 0;
+        decrements = 0;
+    }
+    static size_t Total() {
+        return increments + decrements;
+    }
+};
+
+// Threading policy for `SharedPolicy`, e.g.
+// `SharedPolicy<OpCountingThreaded, WeakSupport::kOn, SharedFromThisSupport::kOff>`.
+// Counts operations on both strong and weak counters.
+struct OpCountingThreaded {
+    class Counter {
+    public:
+        constexpr explicit Counter(size_t value) : value_(value){};
+
+        void Increment() {
+            ++RefcountOps::increments;
+            ++value_;
+        }
+        size_t Decrement() {
+            ++RefcountOps::decrements;
+            return --value_;
+        }
+        // One operation however large `count` is
+        void Add(size_t count) {
+            ++RefcountOps::increments;
+            value_ += count;
+        }
+        size_t Subtract(size_t count) {
+            ++RefcountOps::decrements;
+            return value_ -= count;
+        }
+        bool IncrementIfNonZero() {
+            if (value_ == 0) {
+                return false;
+            }
+            Increment();
+            return true;
+        }
+        size_t Load() const {
+            return value_;
+        }
+
+    private:
+        size_t value_;
+    };
+};
+
+// `Counter` for `RefCounted`, same interface as `SimpleCounter`
+class OpCountingRefCounter {
+public:
+    size_t IncRef() {
+        ++RefcountOps::increments;
+        return ++count_;
+    }
+    size_t DecRef() {
+        ++RefcountOps::decrements;
+        return --count_;
+    }
+    size_t IncRef(size_t count) {
+        ++RefcountOps::increments;
+        return count_ += count;
+    }
+    size_t DecRef(size_t count) {
+        ++RefcountOps::decrements;
+        return count_ -= count;
+    }
+    size_t RefCount() const {
+        return count_;
+    }
+
+private:
+    size_t count_ = 0;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>  // size_t, std::max_align_t
+#include <cstdint>  // std::uint64_t, std::uintptr_t
+#include <functional>
+#include <type_traits>
+
+// Spreads `address >> shift` over all bits: the low `shift` bits are always zero
+// for the addresses hashed, so they are dropped before mixing.
+inline size_t MixPointerBits(const void* ptr, int shift) {
+    uint64_t value = reinterpret_cast<uintptr_t>(ptr) >> shift;
+    // Fibonacci hashing, then fold the well-mixed high half into the low one
+    value *= 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(value ^ (value >> 32));
+}
+
+// Low bits that are zero in every `T*`: none for `void` and incomplete types
+template <typename T>
+constexpr int PointerZeroBits() {
+    if constexpr (requires { sizeof(T); }) {
+        return std::countr_zero(alignof(T));
+    } else {
+        return 0;
+    }
+}
+
+// Any pointer, e.g. a raw key. Only the alignment of `T` is assumed: keys may point
+// into arrays or at small objects, where neighbouring keys differ in the low bits.
+template <typename T>
+size_t HashPointer(const T* ptr) {
+    return MixPointerBits(ptr, PointerZeroBits<T>());
+}
+
+// Control blocks (see `OwnerHash` of the smart pointers) are heap allocations,
+// aligned to `max_align_t`.
+inline size_t HashBlockPointer(const void* block) {
+    return MixPointerBits(block, std::countr_zero(alignof(std::max_align_t)));
+}
+
+// Owner-based comparison and hashing: two `SharedPtr`/`WeakPtr` are equivalent
+// when they share a control block, whatever `Get()` returns (aliasing) and
+// whether the object is still alive (expired `WeakPtr`). Raw pointers are
+// their own owners, so the same functors work for `T*` keys.
+
+struct OwnerLess {
+    template <typename L, typename R>
+    bool operator()(const L& left, const R& right) const {
+        if constexpr (std::is_pointer_v<L>) {
+            return std::less<const void*>()(left, right);
+        } else {
+            return left.OwnerBefore(right);
+        }
+    }
+};
+
+struct OwnerEqual {
+    template <typename L, typename R>
+    bool operator()(const L& left, const R& right) const {
+        if constexpr (std::is_pointer_v<L>) {
+            return static_cast<const void*>(left) == static_cast<const void*>(right);
+        } else {
+            return left.OwnerEqual(right);
+        }
+    }
+};
+
+struct OwnerHash {
+    template <typename T>
+    size_t operator()(const T& value) const {
+        if constexpr (std::is_pointer_v<T>) {
+            return HashPointer(value);
+        } else {
+            return value.OwnerHash();
+        }
+    }
+};
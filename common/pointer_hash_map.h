@@ -0,0 +1,314 @@
+#pragma once
+
+#include <common/owner.h>
+
+#include <algorithm>  // std::fill_n, std::max
+#include <bit>        // std::countr_zero
+#include <cstddef>    // size_t
+#include <cstdint>    // std::uint8_t, std::uint64_t
+#include <memory>     // std::allocator
+#include <new>        // placement new
+#include <utility>
+
+// Open-addressing hash map for identity keys: raw pointers, `SharedPtr`, `WeakPtr`
+// (by owner, see `common/owner.h`), so lookups never chase a node per entry.
+//
+// Swiss-table layout: besides the slots there is one control byte per slot, either
+// empty, deleted, or 7 bits of the key's hash. Slots are probed in aligned groups of 8:
+// one 64-bit load of control bytes and a few bit tricks find every candidate in the group.
+// Values and keys must not throw on move, the table moves them when it grows.
+template <typename Key, typename Value, typename Hash = OwnerHash, typename Equal = OwnerEqual>
+class PointerHashMap {
+public:
+    struct Entry {
+        Key key;
+        Value value;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    PointerHashMap() = default;
+
+    PointerHashMap(const PointerHashMap&) = delete;
+    PointerHashMap& operator=(const PointerHashMap&) = delete;
+
+    PointerHashMap(PointerHashMap&& other) noexcept {
+        Swap(other);
+    }
+
+    PointerHashMap& operator=(PointerHashMap&& other) noexcept {
+        if (this != &other) {
+            PointerHashMap(std::move(other)).Swap(*this);
+        }
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~PointerHashMap() {
+        Clear();
+        Deallocate(ctrl_, slots_, capacity_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    // Constructs the value from `args` unless `key` is already present
+    template <typename... Args>
+    std::pair<Value*, bool> TryEmplace(const Key& key, Args&&... args) {
+        size_t hash = Hash()(key);
+        if (size_t index = FindIndex(key, hash); index != kNotFound) {
+            return {&slots_[index].value, false};
+        }
+        if ((size_ + deleted_ + 1) * 8 > capacity_ * 7) {
+            Rehash(size_ * 2 < capacity_ ? capacity_ : std::max(kGroupWidth, capacity_ * 2));
+        }
+        size_t index = FindInsertIndex(hash);
+        new (slots_ + index) Entry{key, Value(std::forward<Args>(args)...)};
+        if (ctrl_[index] == kDeleted) {
+            --deleted_;
+        }
+        ctrl_[index] = static_cast<uint8_t>(hash & 0x7F);
+        ++size_;
+        return {&slots_[index].value, true};
+    }
+
+    Value& operator[](const Key& key) {
+        return *TryEmplace(key).first;
+    }
+
+    template <typename K>
+    bool Erase(const K& key) {
+        size_t index = FindIndex(key, Hash()(key));
+        if (index == kNotFound) {
+            return false;
+        }
+        EraseAt(index);
+        return true;
+    }
+
+    // Erases every entry for which `pred(key, value)` holds, returns how many
+    template <typename Pred>
+    size_t EraseIf(Pred&& pred) {
+        size_t erased = 0;
+        for (size_t index = 0; index < capacity_; ++index) {
+            if (IsFull(ctrl_[index]) && pred(slots_[index].key, slots_[index].value)) {
+                EraseAt(index);
+                ++erased;
+            }
+        }
+        return erased;
+    }
+
+    void Clear() {
+        for (size_t index = 0; index < capacity_; ++index) {
+            if (IsFull(ctrl_[index])) {
+                slots_[index].~Entry();
+            }
+            ctrl_[index] = kEmpty;
+        }
+        size_ = 0;
+        deleted_ = 0;
+    }
+
+    // Room for `count` entries without rehashing
+    void Reserve(size_t count) {
+        size_t capacity = kGroupWidth;
+        while (capacity * 7 < count * 8) {
+            capacity *= 2;
+        }
+        if (capacity > capacity_) {
+            Rehash(capacity);
+        }
+    }
+
+    void Swap(PointerHashMap& other) noexcept {
+        std::swap(ctrl_, other.ctrl_);
+        std::swap(slots_, other.slots_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(size_, other.size_);
+        std::swap(deleted_, other.deleted_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Lookup
+
+    // `key` may be of any type `Hash` and `Equal` accept, e.g. `SharedPtr` for `WeakPtr` keys
+    template <typename K>
+    Value* Find(const K& key) {
+        size_t index = FindIndex(key, Hash()(key));
+        return index == kNotFound ? nullptr : &slots_[index].value;
+    }
+
+    template <typename K>
+    const Value* Find(const K& key) const {
+        size_t index = FindIndex(key, Hash()(key));
+        return index == kNotFound ? nullptr : &slots_[index].value;
+    }
+
+    template <typename K>
+    bool Contains(const K& key) const {
+        return Find(key) != nullptr;
+    }
+
+    // `fn(key, value)` for every entry, in no particular order
+    template <typename Fn>
+    void ForEach(Fn&& fn) {
+        for (size_t index = 0; index < capacity_; ++index) {
+            if (IsFull(ctrl_[index])) {
+                fn(static_cast<const Key&>(slots_[index].key), slots_[index].value);
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    size_t Size() const {
+        return size_;
+    }
+    bool Empty() const {
+        return size_ == 0;
+    }
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+private:
+    static constexpr size_t kGroupWidth = 8;
+    static constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+    // Full slots store the low 7 hash bits, so the high bit tells them apart
+    static constexpr uint8_t kEmpty = 0x80;
+    static constexpr uint8_t kDeleted = 0xFE;
+
+    static constexpr uint64_t kLsbs = 0x0101010101010101ull;
+    static constexpr uint64_t kMsbs = 0x8080808080808080ull;
+
+    static bool IsFull(uint8_t ctrl) {
+        return ctrl < 0x80;
+    }
+
+    // Control byte `i` of the group ends up in bits [8i, 8i + 8) on any endianness,
+    // compilers turn the loop into a single load on little-endian targets.
+    uint64_t LoadGroup(size_t group) const {
+        const uint8_t* bytes = ctrl_ + group * kGroupWidth;
+        uint64_t word = 0;
+        for (size_t i = 0; i < kGroupWidth; ++i) {
+            word |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+        }
+        return word;
+    }
+
+    // High bit of every byte equal to `h2`. May also flag a full byte right above a match,
+    // which costs one extra key comparison; empty and deleted bytes are never flagged.
+    static uint64_t MatchHash(uint64_t word, uint8_t h2) {
+        uint64_t x = word ^ (kLsbs * h2);
+        return (x - kLsbs) & ~x & kMsbs;
+    }
+
+    // `kEmpty` has bit 1 clear, `kDeleted` has it set
+    static uint64_t MatchEmpty(uint64_t word) {
+        return word & ~(word << 6) & kMsbs;
+    }
+
+    static uint64_t MatchEmptyOrDeleted(uint64_t word) {
+        return word & kMsbs;
+    }
+
+    static size_t FirstByte(uint64_t mask) {
+        return std::countr_zero(mask) / 8;
+    }
+
+    // Triangular probing over power-of-two groups visits every group once
+    template <typename K>
+    size_t FindIndex(const K& key, size_t hash) const {
+        if (capacity_ == 0) {
+            return kNotFound;
+        }
+        size_t group_mask = capacity_ / kGroupWidth - 1;
+        size_t group = (hash >> 7) & group_mask;
+        for (size_t step = 1;; ++step) {
+            uint64_t word = LoadGroup(group);
+            for (uint64_t match = MatchHash(word, hash & 0x7F); match != 0; match &= match - 1) {
+                size_t index = group * kGroupWidth + FirstByte(match);
+                if (Equal()(slots_[index].key, key)) {
+                    return index;
+                }
+            }
+            if (MatchEmpty(word) != 0) {
+                return kNotFound;
+            }
+            group = (group + step) & group_mask;
+        }
+    }
+
+    size_t FindInsertIndex(size_t hash) const {
+        size_t group_mask = capacity_ / kGroupWidth - 1;
+        size_t group = (hash >> 7) & group_mask;
+        for (size_t step = 1;; ++step) {
+            if (uint64_t free = MatchEmptyOrDeleted(LoadGroup(group)); free != 0) {
+                return group * kGroupWidth + FirstByte(free);
+            }
+            group = (group + step) & group_mask;
+        }
+    }
+
+    // Groups are aligned, so if this group still has an empty slot no probe continues
+    // past it and the slot can become empty instead of a tombstone.
+    void EraseAt(size_t index) {
+        slots_[index].~Entry();
+        --size_;
+        if (MatchEmpty(LoadGroup(index / kGroupWidth)) != 0) {
+            ctrl_[index] = kEmpty;
+        } else {
+            ctrl_[index] = kDeleted;
+            ++deleted_;
+        }
+    }
+
+    void Rehash(size_t capacity) {
+        uint8_t* old_ctrl = ctrl_;
+        Entry* old_slots = slots_;
+        size_t old_capacity = capacity_;
+
+        slots_ = std::allocator<Entry>().allocate(capacity);
+        try {
+            ctrl_ = new uint8_t[capacity];
+        } catch (...) {
+            std::allocator<Entry>().deallocate(slots_, capacity);
+            slots_ = old_slots;
+            throw;
+        }
+        std::fill_n(ctrl_, capacity, kEmpty);
+        capacity_ = capacity;
+        deleted_ = 0;
+
+        for (size_t index = 0; index < old_capacity; ++index) {
+            if (IsFull(old_ctrl[index])) {
+                Entry& entry = old_slots[index];
+                size_t hash = Hash()(entry.key);
+                size_t new_index = FindInsertIndex(hash);
+                new (slots_ + new_index) Entry(std::move(entry));
+                ctrl_[new_index] = static_cast<uint8_t>(hash & 0x7F);
+                entry.~Entry();
+            }
+        }
+        Deallocate(old_ctrl, old_slots, old_capacity);
+    }
+
+    static void Deallocate(uint8_t* ctrl, Entry* slots, size_t capacity) {
+        if (capacity != 0) {
+            delete[] ctrl;
+            std::allocator<Entry>().deallocate(slots, capacity);
+        }
+    }
+
+    uint8_t* ctrl_ = nullptr;
+    Entry* slots_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    size_t deleted_ = 0;
+};
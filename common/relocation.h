@@ -0,0 +1,11 @@
+#pragma once
+
+#include <type_traits>
+
+// A type is trivially relocatable if moving an object to new storage and destroying
+// the source is the same as copying its bytes: nothing points back into the object.
+// Smart pointers are, even though their moves and destructors aren't trivial;
+// `SmallVector` grows containers of such types with `memcpy`, no refcount traffic.
+// Specialize for your own types next to their definition.
+template <typename T>
+inline constexpr bool kIsTriviallyRelocatable = std::is_trivially_copyable_v<T>;
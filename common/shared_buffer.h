@@ -0,0 +1,218 @@
+#pragma once
+
+// Include after the directory's `shared.h`, it provides `DefaultSharedPolicy`.
+
+#include <common/shared_core.h>
+#include <common/trailing_array.h>
+
+#include <sys/ioctl.h>  // ioctl, FIONREAD
+#include <sys/types.h>  // ssize_t
+#include <sys/uio.h>    // readv, writev, iovec
+
+#include <algorithm>  // std::min
+#include <climits>    // IOV_MAX
+#include <cstddef>    // size_t, std::byte
+#include <cstring>    // std::memcpy
+#include <deque>
+#include <span>
+#include <utility>
+
+// Bytes and counters in one block, see `MakeSharedWithTrailing`
+struct SharedBufferStorage : TrailingArray<SharedBufferStorage, std::byte> {};
+
+// Refcounted byte range. `Slice` is O(1): the result is an aliasing `SharedPtr` into the
+// same allocation, so layers of a protocol stack can pass sub-ranges without copying.
+// Slices share the bytes: a write through one is seen by every slice that covers it.
+template <typename Policy = DefaultSharedPolicy>
+class BasicSharedBuffer {
+public:
+    BasicSharedBuffer() = default;
+
+    // `size` uninitialized bytes, one allocation
+    static BasicSharedBuffer Allocate(size_t size) {
+        auto storage =
+            MakeSharedWithTrailingForOverwrite<SharedBufferStorage, std::byte, Policy>(size);
+        std::byte* data = storage->Trailing().data();
+        return BasicSharedBuffer(SharedPtr<std::byte, Policy>(std::move(storage), data), size);
+    }
+
+    static BasicSharedBuffer Copy(std::span<const std::byte> bytes) {
+        BasicSharedBuffer buffer = Allocate(bytes.size());
+        if (!bytes.empty()) {
+            std::memcpy(buffer.Data(), bytes.data(), bytes.size());
+        }
+        return buffer;
+    }
+
+    // Bytes `[offset, offset + length)`, sharing the allocation
+    BasicSharedBuffer Slice(size_t offset, size_t length) const& {
+        return BasicSharedBuffer(SharedPtr<std::byte, Policy>(data_, data_.Get() + offset), length);
+    }
+    BasicSharedBuffer Slice(size_t offset, size_t length) && {
+        std::byte* data = data_.Get() + offset;
+        return BasicSharedBuffer(SharedPtr<std::byte, Policy>(std::move(data_), data), length);
+    }
+
+    std::byte* Data() const {
+        return data_.Get();
+    }
+    size_t Size() const {
+        return size_;
+    }
+    bool Empty() const {
+        return size_ == 0;
+    }
+    std::span<std::byte> Span() const {
+        return std::span<std::byte>(data_.Get(), size_);
+    }
+
+    // Buffers and slices sharing the allocation
+    size_t UseCount() const {
+        return data_.UseCount();
+    }
+
+private:
+    BasicSharedBuffer(SharedPtr<std::byte, Policy> data, size_t size)
+        : data_(std::move(data)), size_(size) {
+    }
+
+    SharedPtr<std::byte, Policy> data_;
+    size_t size_ = 0;
+};
+
+// Sequence of buffer slices forming one byte stream, e.g. a message assembled from
+// a header and a payload sliced out of another message. `WriteTo` and `ReadFrom` hand
+// the slices to `writev` / `readv` as they are, nothing is copied into a staging buffer.
+template <typename Policy = DefaultSharedPolicy>
+class BasicByteChain {
+public:
+    using Buffer = BasicSharedBuffer<Policy>;
+
+    void Append(Buffer buffer) {
+        if (!buffer.Empty()) {
+            size_ += buffer.Size();
+            buffers_.push_back(std::move(buffer));
+        }
+    }
+
+    // `other` may be this chain, then its slices are appended once
+    void Append(const BasicByteChain& other) {
+        size_t count = other.buffers_.size();
+        for (size_t i = 0; i < count; ++i) {
+            Append(other.buffers_[i]);
+        }
+    }
+
+    // Drops the first `count` bytes
+    void Consume(size_t count) {
+        Split(count);
+    }
+
+    // Moves the first `count` bytes into a chain of their own, slicing at most one buffer
+    BasicByteChain Split(size_t count) {
+        BasicByteChain front;
+        count = std::min(count, size_);
+        while (count > 0) {
+            Buffer& buffer = buffers_.front();
+            if (buffer.Size() <= count) {
+                count -= buffer.Size();
+                size_ -= buffer.Size();
+                front.Append(std::move(buffer));
+                buffers_.pop_front();
+            } else {
+                front.Append(buffer.Slice(0, count));
+                buffer = std::move(buffer).Slice(count, buffer.Size() - count);
+                size_ -= count;
+                count = 0;
+            }
+        }
+        return front;
+    }
+
+    // Copies the first `out.size()` bytes, the chain is left as is
+    void CopyTo(std::span<std::byte> out) const {
+        size_t copied = 0;
+        for (const Buffer& buffer : buffers_) {
+            if (copied == out.size()) {
+                break;
+            }
+            size_t length = std::min(buffer.Size(), out.size() - copied);
+            std::memcpy(out.data() + copied, buffer.Data(), length);
+            copied += length;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // I/O
+
+    // One `writev` of as many slices as it takes, the written prefix is consumed.
+    // Returns what `writev` returned, `errno` is left for the caller.
+    ssize_t WriteTo(int fd) {
+        iovec iov[kMaxIovecs];
+        size_t count = 0;
+        for (const Buffer& buffer : buffers_) {
+            if (count == kMaxIovecs) {
+                break;
+            }
+            iov[count++] = iovec{buffer.Data(), buffer.Size()};
+        }
+        ssize_t written = writev(fd, iov, static_cast<int>(count));
+        if (written > 0) {
+            Consume(static_cast<size_t>(written));
+        }
+        return written;
+    }
+
+    // One `readv` into fresh buffers of `chunk_size` bytes (at most `max_bytes` in total);
+    // what was read is appended as slices of them. Returns what `readv` returned.
+    // Only as many bytes as `FIONREAD` reports are allocated up front, or a single chunk
+    // if it reports nothing (e.g. a blocking read that has to wait).
+    ssize_t ReadFrom(int fd, size_t max_bytes, size_t chunk_size = 16 * 1024) {
+        int readable = 0;
+        if (ioctl(fd, FIONREAD, &readable) == 0 && readable > 0) {
+            max_bytes = std::min(max_bytes, static_cast<size_t>(readable));
+        } else {
+            max_bytes = std::min(max_bytes, chunk_size);
+        }
+
+        Buffer chunks[kMaxReadChunks];
+        iovec iov[kMaxReadChunks];
+        size_t count = 0;
+        for (size_t left = max_bytes; left > 0 && count < kMaxReadChunks; ++count) {
+            chunks[count] = Buffer::Allocate(std::min(left, chunk_size));
+            iov[count] = iovec{chunks[count].Data(), chunks[count].Size()};
+            left -= chunks[count].Size();
+        }
+        ssize_t read = readv(fd, iov, static_cast<int>(count));
+        size_t left = read > 0 ? static_cast<size_t>(read) : 0;
+        for (size_t i = 0; i < count && left > 0; ++i) {
+            size_t length = std::min(left, chunks[i].Size());
+            Append(std::move(chunks[i]).Slice(0, length));
+            left -= length;
+        }
+        return read;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    size_t Size() const {
+        return size_;
+    }
+    bool Empty() const {
+        return size_ == 0;
+    }
+    size_t BufferCount() const {
+        return buffers_.size();
+    }
+
+private:
+    static constexpr size_t kMaxIovecs = IOV_MAX < 1024 ? IOV_MAX : 1024;
+    static constexpr size_t kMaxReadChunks = 16;
+
+    std::deque<Buffer> buffers_;
+    size_t size_ = 0;
+};
+
+using SharedBuffer = BasicSharedBuffer<DefaultSharedPolicy>;
+using ByteChain = BasicByteChain<DefaultSharedPolicy>;
@@ -0,0 +1,986 @@
+#pragma once
+
+// Policy-based `SharedPtr` behind `shared/`, `weak/` and `shared-from-this/`.
+// Include it through a directory's `shared.h`: its `sw_fwd.h` picks `DefaultSharedPolicy`.
+
+#include <common/compressed_tuple.h>
+#include <common/owner.h>
+#include <common/shared_fwd.h>
+#include <common/trailing_array.h>
+
+#include <algorithm>  // std::sort
+#include <atomic>
+#include <cstddef>     // std::nullptr_t
+#include <cstdint>     // std::uintptr_t
+#include <functional>  // std::less, std::function
+#include <new>         // std::launder
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// https://en.cppreference.com/w/cpp/memory/shared_ptr
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Control block interfaces
+
+// Enough for `SharedPtr` without weak support
+class BaseControlBlock {
+public:
+    virtual ~BaseControlBlock(){};
+    virtual void IncreaseStrongCounter() = 0;
+    virtual void DecreaseStrongCounter() = 0;
+    virtual size_t GetStrongCounter() = 0;
+    // `count` references at once, e.g. for every copy of one pointer in a `SharedPtrVector`
+    virtual void IncreaseStrongCounterBy(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            IncreaseStrongCounter();
+        }
+    }
+    virtual void DecreaseStrongCounterBy(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            DecreaseStrongCounter();
+        }
+    }
+};
+
+// Blocks that `WeakPtr` can point to as well
+class WeakControlBlock : public BaseControlBlock {
+public:
+    virtual void IncreaseWeakCounter() = 0;
+    virtual void DecreaseWeakCounter() = 0;
+    // Takes a strong reference unless the object is already dead
+    virtual bool TryIncreaseStrongCounter() = 0;
+    // See `WeakPtr::OnExpire`. On failure `hook` is left to the caller.
+    virtual bool AddExpiryHook(std::function<void()>& /*hook*/) {
+        return false;
+    }
+};
+
+template <typename Policy>
+using ControlBlockOf =
+    std::conditional_t<Policy::kWeakSupport, WeakControlBlock, BaseControlBlock>;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Static blocks
+
+// Empty `SharedPtr`/`WeakPtr` may point to a static immortal block instead of nullptr,
+// then refcount calls on them need no null check. Opt in with SMART_PTRS_EMPTY_SENTINEL.
+#ifdef SMART_PTRS_EMPTY_SENTINEL
+inline constexpr bool kEmptySentinelBlock = true;
+#else
+inline constexpr bool kEmptySentinelBlock = false;
+#endif
+
+// Every operation is a no-op, the block is never freed
+class SentinelControlBlock : public WeakControlBlock {
+public:
+    constexpr SentinelControlBlock() = default;
+    void IncreaseStrongCounter() override {
+    }
+    void DecreaseStrongCounter() override {
+    }
+    void IncreaseStrongCounterBy(size_t /*count*/) override {
+    }
+    void DecreaseStrongCounterBy(size_t /*count*/) override {
+    }
+    void IncreaseWeakCounter() override {
+    }
+    void DecreaseWeakCounter() override {
+    }
+    bool TryIncreaseStrongCounter() override {
+        return false;
+    }
+    size_t GetStrongCounter() override {
+        return 0;
+    }
+};
+
+inline constinit SentinelControlBlock sentinel_control_block;
+
+inline SentinelControlBlock* EmptyControlBlock() {
+    if constexpr (kEmptySentinelBlock) {
+        return &sentinel_control_block;
+    } else {
+        return nullptr;
+    }
+}
+
+// Folds to `true` in sentinel mode, so callers compile to an unconditional call
+inline bool HasControlBlock(const BaseControlBlock* block) {
+    return kEmptySentinelBlock || block != nullptr;
+}
+
+// Shared by all immortal objects (see `ImmortalShared`): counting is a no-op,
+// the object always looks alive and is never destroyed.
+class ImmortalControlBlock : public WeakControlBlock {
+public:
+    constexpr ImmortalControlBlock() = default;
+    void IncreaseStrongCounter() override {
+    }
+    void DecreaseStrongCounter() override {
+    }
+    void IncreaseStrongCounterBy(size_t /*count*/) override {
+    }
+    void DecreaseStrongCounterBy(size_t /*count*/) override {
+    }
+    void IncreaseWeakCounter() override {
+    }
+    void DecreaseWeakCounter() override {
+    }
+    bool TryIncreaseStrongCounter() override {
+        return true;
+    }
+    size_t GetStrongCounter() override {
+        return 1;
+    }
+};
+
+inline constinit ImmortalControlBlock immortal_control_block;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Owning blocks
+
+// Callbacks for the strong 1 -> 0 transition, a lock-free stack that is closed when fired.
+// The empty specialization keeps blocks of policies without hooks as small as before.
+template <bool Enabled>
+class ExpiryHookList {
+public:
+    bool Add(std::function<void()>& /*hook*/) {
+        return false;
+    }
+    void Fire() {
+    }
+};
+
+template <>
+class ExpiryHookList<true> {
+public:
+    ExpiryHookList() = default;
+
+    ExpiryHookList(const ExpiryHookList&) = delete;
+    ExpiryHookList& operator=(const ExpiryHookList&) = delete;
+
+    // Fails once the hooks have fired, `hook` is handed back then
+    bool Add(std::function<void()>& hook) {
+        Node* node = new Node{std::move(hook), head_.load(std::memory_order_acquire)};
+        while (node->next != Closed()) {
+            if (head_.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                            std::memory_order_acquire)) {
+                return true;
+            }
+        }
+        hook = std::move(node->hook);
+        delete node;
+        return false;
+    }
+
+    // Newest hook first
+    void Fire() {
+        Node* node = head_.exchange(Closed(), std::memory_order_acq_rel);
+        while (node) {
+            node->hook();
+            delete std::exchange(node, node->next);
+        }
+    }
+
+private:
+    struct Node {
+        std::function<void()> hook;
+        Node* next;
+    };
+
+    static Node* Closed() {
+        static Node closed;
+        return &closed;
+    }
+
+    std::atomic<Node*> head_ = nullptr;
+};
+
+// Counting shared by the owning blocks, they only define how the object dies.
+template <typename Policy, bool = Policy::kWeakSupport>
+class CountingControlBlock;
+
+template <typename Policy>
+class CountingControlBlock<Policy, false> : public BaseControlBlock {
+public:
+    void IncreaseStrongCounter() final {
+        strong_counter_.Increment();
+    }
+    void DecreaseStrongCounter() final {
+        if (strong_counter_.Decrement() == 0) {
+            DestroyObject();
+            delete this;
+        }
+    }
+    void IncreaseStrongCounterBy(size_t count) final {
+        strong_counter_.Add(count);
+    }
+    void DecreaseStrongCounterBy(size_t count) final {
+        if (strong_counter_.Subtract(count) == 0) {
+            DestroyObject();
+            delete this;
+        }
+    }
+    size_t GetStrongCounter() final {
+        return strong_counter_.Load();
+    }
+
+protected:
+    virtual void DestroyObject() = 0;
+
+private:
+    typename Policy::Counter strong_counter_{1};
+};
+
+// All strong owners together hold one weak reference: the block is freed by whoever
+// drops the weak counter to zero, never twice and never under a dying object.
+template <typename Policy>
+class CountingControlBlock<Policy, true> : public WeakControlBlock {
+public:
+    void IncreaseStrongCounter() final {
+        strong_counter_.Increment();
+    }
+    void DecreaseStrongCounter() final {
+        if (strong_counter_.Decrement() == 0) {
+            DestroyObject();
+            expiry_hooks_.Fire();
+            DecreaseWeakCounter();
+        }
+    }
+    void IncreaseStrongCounterBy(size_t count) final {
+        strong_counter_.Add(count);
+    }
+    void DecreaseStrongCounterBy(size_t count) final {
+        if (strong_counter_.Subtract(count) == 0) {
+            DestroyObject();
+            expiry_hooks_.Fire();
+            DecreaseWeakCounter();
+        }
+    }
+    bool TryIncreaseStrongCounter() final {
+        return strong_counter_.IncrementIfNonZero();
+    }
+    bool AddExpiryHook(std::function<void()>& hook) final {
+        return expiry_hooks_.Add(hook);
+    }
+    size_t GetStrongCounter() final {
+        return strong_counter_.Load();
+    }
+    void IncreaseWeakCounter() final {
+        weak_counter_.Increment();
+    }
+    void DecreaseWeakCounter() final {
+        if (weak_counter_.Decrement() == 0) {
+            delete this;
+        }
+    }
+
+protected:
+    virtual void DestroyObject() = 0;
+
+private:
+    typename Policy::Counter strong_counter_{1};
+    typename Policy::Counter weak_counter_{1};
+    [[no_unique_address]] ExpiryHookList<Policy::kExpiryHooks> expiry_hooks_;
+};
+
+template <typename T, typename Policy>
+class PtrControlBlock : public CountingControlBlock<Policy> {
+public:
+    explicit PtrControlBlock(T* ptr) : control_ptr_(ptr){};
+
+protected:
+    void DestroyObject() override {
+        delete control_ptr_;
+        control_ptr_ = nullptr;
+    }
+
+private:
+    T* control_ptr_;
+};
+
+// Stateless deleters (e.g. `FunctionDeleter`) take no space next to the pointer
+template <typename T, typename Deleter, typename Policy>
+class DeleterControlBlock : public CountingControlBlock<Policy> {
+public:
+    DeleterControlBlock(T* ptr, Deleter deleter) : ptr_and_deleter_(ptr, std::move(deleter)){};
+
+protected:
+    void DestroyObject() override {
+        ptr_and_deleter_.template Get<1>()(ptr_and_deleter_.template Get<0>());
+    }
+
+private:
+    CompressedTuple<T*, Deleter> ptr_and_deleter_;
+};
+
+template <typename T, typename Policy>
+class ObjectControlBlock : public CountingControlBlock<Policy> {
+public:
+    template <typename... Args>
+    explicit ObjectControlBlock(Args&&... args) {
+        new (&buffer_) T(std::forward<Args>(args)...);
+    }
+
+    T* GetObjectPtr() {
+        return std::launder(reinterpret_cast<T*>(&buffer_));
+    }
+
+protected:
+    void DestroyObject() override {
+        GetObjectPtr()->~T();
+    }
+
+private:
+    std::aligned_storage_t<sizeof(T), alignof(T)> buffer_;
+};
+
+// Counters, object and its trailing elements share one allocation,
+// `buffer_` must stay the last member so the elements fit right after it.
+template <typename T, typename Policy>
+class TrailingControlBlock : public CountingControlBlock<Policy> {
+public:
+    template <bool kValueInit = true, typename... Args>
+    static TrailingControlBlock* Create(size_t n, Args&&... args) {
+        static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__ &&
+                          alignof(typename T::TrailingElement) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+                      "Over-aligned trailing objects are not supported");
+        void* raw = ::operator new(sizeof(TrailingControlBlock) - sizeof(T) +
+                                   TrailingArrayAccess::AllocationSize<T>(n));
+        try {
+            return new (raw) TrailingControlBlock(std::bool_constant<kValueInit>(), n,
+                                                  std::forward<Args>(args)...);
+        } catch (...) {
+            ::operator delete(raw);
+            throw;
+        }
+    }
+
+    // Pairs with the raw `::operator new` in `Create`
+    static void operator delete(void* ptr) {
+        ::operator delete(ptr);
+    }
+
+    T* GetObjectPtr() {
+        return std::launder(reinterpret_cast<T*>(&buffer_));
+    }
+
+protected:
+    void DestroyObject() override {
+        TrailingArrayAccess::DestroyElements(GetObjectPtr());
+        GetObjectPtr()->~T();
+    }
+
+private:
+    template <bool kValueInit, typename... Args>
+    TrailingControlBlock(std::bool_constant<kValueInit>, size_t n, Args&&... args) {
+        T* object_ptr = new (&buffer_) T(std::forward<Args>(args)...);
+        try {
+            TrailingArrayAccess::ConstructElements<T, kValueInit>(object_ptr, n);
+        } catch (...) {
+            object_ptr->~T();
+            throw;
+        }
+    }
+
+    // The elements sit at `TrailingOffset()` from the object, which is only aligned for them
+    // if the object is: the counters before `buffer_` may leave it at any multiple of 8
+    std::aligned_storage_t<sizeof(T), std::max(alignof(T), alignof(typename T::TrailingElement))>
+        buffer_;
+};
+
+// Weak count kept out of line, allocated by the first `WeakPtr` to the object.
+struct WeakSideTable {
+    size_t strong_counter;
+    size_t weak_counter;
+};
+
+// Strong count and the side-table pointer share one word: an even word is
+// `strong << 1`, an odd one is the side-table address with the low bit set.
+// Once the table exists the strong count moves there as well. Without a table
+// the weak count is the single reference all strong owners hold together.
+class LazyWeakCounter {
+public:
+    LazyWeakCounter() : word_(2){};
+
+    LazyWeakCounter(const LazyWeakCounter&) = delete;
+    LazyWeakCounter& operator=(const LazyWeakCounter&) = delete;
+
+    ~LazyWeakCounter() {
+        delete GetSideTable();
+    }
+
+    size_t GetStrong() const {
+        if (WeakSideTable* table = GetSideTable()) {
+            return table->strong_counter;
+        }
+        return word_ >> 1;
+    }
+    void IncreaseStrong() {
+        if (WeakSideTable* table = GetSideTable()) {
+            ++table->strong_counter;
+        } else {
+            word_ += 2;
+        }
+    }
+    size_t DecreaseStrong() {
+        if (WeakSideTable* table = GetSideTable()) {
+            return --table->strong_counter;
+        }
+        word_ -= 2;
+        return word_ >> 1;
+    }
+
+    void IncreaseWeak() {
+        if (!GetSideTable()) {
+            WeakSideTable* table = new WeakSideTable{word_ >> 1, 1};
+            word_ = reinterpret_cast<uintptr_t>(table) | 1;
+        }
+        ++GetSideTable()->weak_counter;
+    }
+    size_t DecreaseWeak() {
+        if (WeakSideTable* table = GetSideTable()) {
+            return --table->weak_counter;
+        }
+        return 0;
+    }
+
+private:
+    WeakSideTable* GetSideTable() const {
+        if (word_ & 1) {
+            return reinterpret_cast<WeakSideTable*>(word_ & ~uintptr_t{1});
+        }
+        return nullptr;
+    }
+
+    uintptr_t word_;
+};
+
+// `ObjectControlBlock` for objects that are rarely weak-referenced:
+// no inline weak count, see `MakeSharedLazyWeak`. Single-threaded only.
+template <typename T>
+class LazyWeakControlBlock : public WeakControlBlock {
+public:
+    template <typename... Args>
+    explicit LazyWeakControlBlock(Args&&... args) {
+        new (&buffer_) T(std::forward<Args>(args)...);
+    }
+    void IncreaseStrongCounter() override {
+        counter_.IncreaseStrong();
+    }
+    void DecreaseStrongCounter() override {
+        if (counter_.DecreaseStrong() == 0) {
+            GetObjectPtr()->~T();
+            DecreaseWeakCounter();
+        }
+    }
+    bool TryIncreaseStrongCounter() override {
+        if (counter_.GetStrong() == 0) {
+            return false;
+        }
+        counter_.IncreaseStrong();
+        return true;
+    }
+    size_t GetStrongCounter() override {
+        return counter_.GetStrong();
+    }
+    void IncreaseWeakCounter() override {
+        counter_.IncreaseWeak();
+    }
+    void DecreaseWeakCounter() override {
+        if (counter_.DecreaseWeak() == 0) {
+            delete this;
+        }
+    }
+
+    T* GetObjectPtr() {
+        return std::launder(reinterpret_cast<T*>(&buffer_));
+    }
+
+private:
+    LazyWeakCounter counter_;
+    std::aligned_storage_t<sizeof(T), alignof(T)> buffer_;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// SharedPtr
+
+template <typename T, typename Policy>
+class SharedPtr {
+    using ControlBlock = ControlBlockOf<Policy>;
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    SharedPtr() noexcept : base_block_(EmptyControlBlock()), observed_ptr_(nullptr){};
+
+    SharedPtr(std::nullptr_t) noexcept : base_block_(EmptyControlBlock()), observed_ptr_(nullptr){};
+
+    template <typename Y>
+    explicit SharedPtr(Y* ptr) {
+        try {
+            base_block_ = new PtrControlBlock<Y, Policy>(ptr);
+        } catch (...) {
+            delete ptr;
+            throw;
+        }
+        observed_ptr_ = ptr;
+        InitWeakThisIfNeeded(ptr);
+    }
+
+    // `deleter(ptr)` is called instead of `delete ptr`, also if allocating the block fails
+    template <typename Y, typename Deleter>
+    SharedPtr(Y* ptr, Deleter deleter) {
+        try {
+            base_block_ = new DeleterControlBlock<Y, Deleter, Policy>(ptr, std::move(deleter));
+        } catch (...) {
+            deleter(ptr);
+            throw;
+        }
+        observed_ptr_ = ptr;
+        InitWeakThisIfNeeded(ptr);
+    }
+
+    SharedPtr(const SharedPtr& other) {
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+        if (HasControlBlock(base_block_)) {
+            base_block_->IncreaseStrongCounter();
+        }
+    }
+
+    template <typename Y>
+    SharedPtr(const SharedPtr<Y, Policy>& other) {
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+        if (HasControlBlock(base_block_)) {
+            base_block_->IncreaseStrongCounter();
+        }
+    }
+
+    SharedPtr(SharedPtr&& other) noexcept {
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+        other.base_block_ = EmptyControlBlock();
+        other.observed_ptr_ = nullptr;
+    }
+
+    template <typename Y>
+    SharedPtr(SharedPtr<Y, Policy>&& other) noexcept {
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+        other.base_block_ = EmptyControlBlock();
+        other.observed_ptr_ = nullptr;
+    }
+
+    // Aliasing constructor
+    // #8 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
+    template <typename Y>
+    SharedPtr(const SharedPtr<Y, Policy>& other, T* ptr) {
+        base_block_ = other.base_block_;
+        if (HasControlBlock(base_block_)) {
+            base_block_->IncreaseStrongCounter();
+        }
+        observed_ptr_ = ptr;
+    }
+
+    // Takes over the reference of `other`, no counter is touched
+    template <typename Y>
+    SharedPtr(SharedPtr<Y, Policy>&& other, T* ptr) noexcept {
+        base_block_ = other.base_block_;
+        observed_ptr_ = ptr;
+        other.base_block_ = EmptyControlBlock();
+        other.observed_ptr_ = nullptr;
+    }
+
+    // Promote `WeakPtr`
+    // #11 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
+    explicit SharedPtr(const WeakPtr<T, Policy>& other)
+        requires Policy::kWeakSupport
+    {
+        if (!HasControlBlock(other.base_block_) || !other.base_block_->TryIncreaseStrongCounter()) {
+            throw BadWeakPtr();
+        }
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+    }
+
+    // Also drops the weak reference of `other`, unless it throws
+    explicit SharedPtr(WeakPtr<T, Policy>&& other)
+        requires Policy::kWeakSupport
+        : SharedPtr(std::as_const(other)) {
+        other.Reset();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    SharedPtr& operator=(const SharedPtr& other) {
+        if (this != &other) {
+            if (HasControlBlock(other.base_block_)) {
+                other.base_block_->IncreaseStrongCounter();
+            }
+            if (HasControlBlock(base_block_)) {
+                base_block_->DecreaseStrongCounter();
+            }
+            base_block_ = other.base_block_;
+            observed_ptr_ = other.observed_ptr_;
+        }
+        return *this;
+    }
+
+    template <typename Y>
+    SharedPtr& operator=(const SharedPtr<Y, Policy>& other) {
+        if (HasControlBlock(other.base_block_)) {
+            other.base_block_->IncreaseStrongCounter();
+        }
+        if (HasControlBlock(base_block_)) {
+            base_block_->DecreaseStrongCounter();
+        }
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+        return *this;
+    }
+
+    SharedPtr& operator=(SharedPtr&& other) noexcept {
+        if (this != &other) {
+            if (HasControlBlock(base_block_)) {
+                base_block_->DecreaseStrongCounter();
+            }
+            base_block_ = other.base_block_;
+            observed_ptr_ = other.observed_ptr_;
+            other.base_block_ = EmptyControlBlock();
+            other.observed_ptr_ = nullptr;
+        }
+        return *this;
+    }
+
+    template <typename Y>
+    SharedPtr& operator=(SharedPtr<Y, Policy>&& other) noexcept {
+        if (HasControlBlock(base_block_)) {
+            base_block_->DecreaseStrongCounter();
+        }
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+        other.base_block_ = EmptyControlBlock();
+        other.observed_ptr_ = nullptr;
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~SharedPtr() {
+        if (HasControlBlock(base_block_)) {
+            base_block_->DecreaseStrongCounter();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void SetBlockPtr(ControlBlock* ptr) {
+        base_block_ = ptr;
+    }
+    void SetObservedPtr(T* ptr) {
+        observed_ptr_ = ptr;
+    }
+    void Reset() {
+        if (HasControlBlock(base_block_)) {
+            base_block_->DecreaseStrongCounter();
+        }
+        base_block_ = EmptyControlBlock();
+        observed_ptr_ = nullptr;
+    }
+    template <typename Y>
+    void Reset(Y* ptr) {
+        SharedPtr(ptr).Swap(*this);
+    }
+    template <typename Y, typename Deleter>
+    void Reset(Y* ptr, Deleter deleter) {
+        SharedPtr(ptr, std::move(deleter)).Swap(*this);
+    }
+    void Swap(SharedPtr& other) noexcept {
+        std::swap(base_block_, other.base_block_);
+        std::swap(observed_ptr_, other.observed_ptr_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return observed_ptr_;
+    }
+    T& operator*() const {
+        return *observed_ptr_;
+    }
+    T* operator->() const {
+        return observed_ptr_;
+    }
+    size_t UseCount() const {
+        if (HasControlBlock(base_block_)) {
+            return base_block_->GetStrongCounter();
+        }
+        return 0;
+    }
+    explicit operator bool() const {
+        return observed_ptr_ != nullptr;
+    }
+
+    // Owner-based observers, compare control blocks instead of `Get()` (see `common/owner.h`)
+    template <typename Other>
+    bool OwnerBefore(const Other& other) const {
+        return std::less<const void*>()(base_block_, other.base_block_);
+    }
+    template <typename Other>
+    bool OwnerEqual(const Other& other) const {
+        return static_cast<const void*>(base_block_) == static_cast<const void*>(other.base_block_);
+    }
+    size_t OwnerHash() const {
+        return HashBlockPointer(base_block_);
+    }
+
+    // Binds `weak_this_` once, when the object gets its first owner
+    // (`SharedPtr(Y*)`, `Reset(Y*)`, `MakeShared`); copies and moves never touch it.
+    template <typename Y>
+    void InitWeakThisIfNeeded(Y* ptr) {
+        if constexpr (Policy::kSharedFromThisSupport &&
+                      std::is_convertible_v<Y*, EnableSharedFromThisBase*>) {
+            if (ptr) {
+                InitWeakThis(ptr);
+            }
+        }
+    }
+
+    template <typename Y>
+    void InitWeakThis(EnableSharedFromThis<Y, Policy>* e) {
+        if (e->weak_this_.Expired()) {
+            e->weak_this_ = WeakPtr<T, Policy>(*this);
+        }
+    }
+
+private:
+    template <typename Y, typename P>
+    friend class SharedPtr;
+    template <typename Y, typename P>
+    friend class WeakPtr;
+    template <typename Y, typename P>
+    friend class ObserverList;
+    template <typename Y, typename P>
+    friend class SharedPtrVector;
+    template <typename Y, typename P>
+    friend class WeakPtrSet;
+    template <typename Y, typename P>
+    friend std::vector<SharedPtr<Y, P>> RetainAll(std::span<const SharedPtr<Y, P>> ptrs);
+    template <typename Y, typename P>
+    friend void ReleaseAll(std::span<SharedPtr<Y, P>> ptrs);
+    ControlBlock* base_block_;
+    T* observed_ptr_;
+};
+
+template <typename T, typename U, typename Policy>
+inline bool operator==(const SharedPtr<T, Policy>& left, const SharedPtr<U, Policy>& right) {
+    return left.Get() == right.Get();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Casts
+// https://en.cppreference.com/w/cpp/memory/shared_ptr/pointer_cast
+// Rvalue overloads hand the reference over instead of an increment / decrement pair.
+
+template <typename T, typename Y, typename Policy>
+SharedPtr<T, Policy> StaticPointerCast(const SharedPtr<Y, Policy>& ptr) {
+    return SharedPtr<T, Policy>(ptr, static_cast<T*>(ptr.Get()));
+}
+
+template <typename T, typename Y, typename Policy>
+SharedPtr<T, Policy> StaticPointerCast(SharedPtr<Y, Policy>&& ptr) {
+    T* cast_ptr = static_cast<T*>(ptr.Get());
+    return SharedPtr<T, Policy>(std::move(ptr), cast_ptr);
+}
+
+template <typename T, typename Y, typename Policy>
+SharedPtr<T, Policy> ConstPointerCast(const SharedPtr<Y, Policy>& ptr) {
+    return SharedPtr<T, Policy>(ptr, const_cast<T*>(ptr.Get()));
+}
+
+template <typename T, typename Y, typename Policy>
+SharedPtr<T, Policy> ConstPointerCast(SharedPtr<Y, Policy>&& ptr) {
+    T* cast_ptr = const_cast<T*>(ptr.Get());
+    return SharedPtr<T, Policy>(std::move(ptr), cast_ptr);
+}
+
+template <typename T, typename Y, typename Policy>
+SharedPtr<T, Policy> DynamicPointerCast(const SharedPtr<Y, Policy>& ptr) {
+    if (T* cast_ptr = dynamic_cast<T*>(ptr.Get())) {
+        return SharedPtr<T, Policy>(ptr, cast_ptr);
+    }
+    return SharedPtr<T, Policy>();
+}
+
+// `ptr` keeps its reference if the cast fails
+template <typename T, typename Y, typename Policy>
+SharedPtr<T, Policy> DynamicPointerCast(SharedPtr<Y, Policy>&& ptr) {
+    if (T* cast_ptr = dynamic_cast<T*>(ptr.Get())) {
+        return SharedPtr<T, Policy>(std::move(ptr), cast_ptr);
+    }
+    return SharedPtr<T, Policy>();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Bulk refcounting
+// Pointers are grouped by control block, each distinct block gets one
+// `IncreaseStrongCounterBy(k)` / `DecreaseStrongCounterBy(k)` instead of `k` single operations.
+
+// Calls `fn(block, count)` once per distinct block of `blocks`, sorts `blocks`
+template <typename ControlBlock, typename Fn>
+void ForEachBlockGroup(std::vector<ControlBlock*>& blocks, Fn fn) {
+    std::sort(blocks.begin(), blocks.end(), std::less<ControlBlock*>());
+    for (size_t begin = 0, end; begin < blocks.size(); begin = end) {
+        end = begin + 1;
+        while (end < blocks.size() && blocks[end] == blocks[begin]) {
+            ++end;
+        }
+        fn(blocks[begin], end - begin);
+    }
+}
+
+// Copies of every pointer of `ptrs`
+template <typename T, typename Policy>
+std::vector<SharedPtr<T, Policy>> RetainAll(std::span<const SharedPtr<T, Policy>> ptrs) {
+    using ControlBlock = ControlBlockOf<Policy>;
+    std::vector<SharedPtr<T, Policy>> copies(ptrs.size());
+    std::vector<ControlBlock*> blocks;
+    blocks.reserve(ptrs.size());
+    for (const SharedPtr<T, Policy>& ptr : ptrs) {
+        if (HasControlBlock(ptr.base_block_)) {
+            blocks.push_back(ptr.base_block_);
+        }
+    }
+    ForEachBlockGroup(blocks, [](ControlBlock* block, size_t count) {
+        block->IncreaseStrongCounterBy(count);
+    });
+    for (size_t i = 0; i < ptrs.size(); ++i) {
+        copies[i].SetBlockPtr(ptrs[i].base_block_);
+        copies[i].SetObservedPtr(ptrs[i].observed_ptr_);
+    }
+    return copies;
+}
+
+template <typename T, typename Policy>
+std::vector<SharedPtr<T, Policy>> RetainAll(const std::vector<SharedPtr<T, Policy>>& ptrs) {
+    return RetainAll(std::span<const SharedPtr<T, Policy>>(ptrs));
+}
+
+// Resets every pointer of `ptrs`. All of them are empty before the first object dies.
+template <typename T, typename Policy>
+void ReleaseAll(std::span<SharedPtr<T, Policy>> ptrs) {
+    using ControlBlock = ControlBlockOf<Policy>;
+    std::vector<ControlBlock*> blocks;
+    blocks.reserve(ptrs.size());
+    for (SharedPtr<T, Policy>& ptr : ptrs) {
+        if (HasControlBlock(ptr.base_block_)) {
+            blocks.push_back(ptr.base_block_);
+        }
+        ptr.base_block_ = EmptyControlBlock();
+        ptr.observed_ptr_ = nullptr;
+    }
+    ForEachBlockGroup(blocks, [](ControlBlock* block, size_t count) {
+        block->DecreaseStrongCounterBy(count);
+    });
+}
+
+template <typename T, typename Policy>
+void ReleaseAll(std::vector<SharedPtr<T, Policy>>& ptrs) {
+    ReleaseAll(std::span<SharedPtr<T, Policy>>(ptrs));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Factories
+
+// Objects at least this big are allocated apart from the counters by `MakeShared`,
+// so a lingering `WeakPtr` pins only the small block and not the dead object.
+inline constexpr size_t kMakeSharedSplitThreshold = 4096;
+
+// Counters and object in separate allocations: the object's memory is returned
+// as soon as the last `SharedPtr` dies, whatever number of `WeakPtr`s is left.
+template <typename T, typename Policy = DefaultSharedPolicy, typename... Args>
+SharedPtr<T, Policy> MakeSharedSplit(Args&&... args) {
+    return SharedPtr<T, Policy>(new T(std::forward<Args>(args)...));
+}
+
+// Allocate memory only once (unless `T` is big and weak references are possible,
+// see `kMakeSharedSplitThreshold`)
+template <typename T, typename Policy = DefaultSharedPolicy, typename... Args>
+SharedPtr<T, Policy> MakeShared(Args&&... args) {
+    if constexpr (Policy::kWeakSupport && sizeof(T) >= kMakeSharedSplitThreshold) {
+        return MakeSharedSplit<T, Policy>(std::forward<Args>(args)...);
+    } else {
+        SharedPtr<T, Policy> return_ptr;
+        ObjectControlBlock<T, Policy>* object_block_ptr =
+            new ObjectControlBlock<T, Policy>(std::forward<Args>(args)...);
+        return_ptr.SetObservedPtr(object_block_ptr->GetObjectPtr());
+        return_ptr.SetBlockPtr(object_block_ptr);
+        return_ptr.InitWeakThisIfNeeded(object_block_ptr->GetObjectPtr());
+        return return_ptr;
+    }
+}
+
+// Like `MakeShared`, but the block only grows a weak count once the first `WeakPtr` appears.
+// Smaller block for objects that never get weak-referenced, one more allocation for those that do.
+template <typename T, typename Policy = DefaultSharedPolicy, typename... Args>
+SharedPtr<T, Policy> MakeSharedLazyWeak(Args&&... args) {
+    static_assert(Policy::kWeakSupport, "Use MakeShared, there are no weak counts to save");
+    static_assert(std::is_same_v<typename Policy::Counter, SingleThreaded::Counter>,
+                  "The side table is installed without synchronization");
+    static_assert(!Policy::kExpiryHooks,
+                  "LazyWeakControlBlock has no expiry hooks, OnExpire would drop them");
+    SharedPtr<T, Policy> return_ptr;
+    LazyWeakControlBlock<T>* block_ptr = new LazyWeakControlBlock<T>(std::forward<Args>(args)...);
+    return_ptr.SetObservedPtr(block_ptr->GetObjectPtr());
+    return_ptr.SetBlockPtr(block_ptr);
+    return_ptr.InitWeakThisIfNeeded(block_ptr->GetObjectPtr());
+    return return_ptr;
+}
+
+// Shares a static / `constinit` object without any refcount traffic.
+// `object` must outlive every copy, `UseCount()` of the result is always 1.
+// `weak_this_` of such objects stays unbound.
+template <typename T, typename Policy = DefaultSharedPolicy>
+SharedPtr<T, Policy> ImmortalShared(T& object) {
+    SharedPtr<T, Policy> return_ptr;
+    return_ptr.SetObservedPtr(&object);
+    return_ptr.SetBlockPtr(&immortal_control_block);
+    return return_ptr;
+}
+
+// Header and `n` default-constructed trailing elements next to the counters, one allocation.
+// `T` derives from `TrailingArray<T, Elem>`, elements are reachable via `Trailing()`.
+template <typename T, typename Elem, typename Policy = DefaultSharedPolicy, typename... Args>
+SharedPtr<T, Policy> MakeSharedWithTrailing(size_t n, Args&&... args) {
+    static_assert(std::is_base_of_v<TrailingArray<T, Elem>, T>, "T must derive from TrailingArray");
+    SharedPtr<T, Policy> return_ptr;
+    TrailingControlBlock<T, Policy>* block_ptr =
+        TrailingControlBlock<T, Policy>::Create(n, std::forward<Args>(args)...);
+    return_ptr.SetObservedPtr(block_ptr->GetObjectPtr());
+    return_ptr.SetBlockPtr(block_ptr);
+    return_ptr.InitWeakThisIfNeeded(block_ptr->GetObjectPtr());
+    return return_ptr;
+}
+
+// Same, but the elements are default-initialized: trivial ones, e.g. bytes about to be
+// filled by `read`, are not zeroed first.
+template <typename T, typename Elem, typename Policy = DefaultSharedPolicy, typename... Args>
+SharedPtr<T, Policy> MakeSharedWithTrailingForOverwrite(size_t n, Args&&... args) {
+    static_assert(std::is_base_of_v<TrailingArray<T, Elem>, T>, "T must derive from TrailingArray");
+    SharedPtr<T, Policy> return_ptr;
+    TrailingControlBlock<T, Policy>* block_ptr =
+        TrailingControlBlock<T, Policy>::template Create<false>(n, std::forward<Args>(args)...);
+    return_ptr.SetObservedPtr(block_ptr->GetObjectPtr());
+    return_ptr.SetBlockPtr(block_ptr);
+    return_ptr.InitWeakThisIfNeeded(block_ptr->GetObjectPtr());
+    return return_ptr;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <common/relocation.h>
+#include <common/shared_policy.h>
+
+#include <exception>
+
+// Instead of std::bad_weak_ptr
+class BadWeakPtr : public std::exception {};
+
+class EnableSharedFromThisBase {};
+
+// Every `sw_fwd.h` redeclares these with its own `DefaultSharedPolicy` as the default argument
+template <typename T, typename Policy>
+class SharedPtr;
+
+template <typename T, typename Policy>
+class WeakPtr;
+
+template <typename T, typename Policy>
+class EnableSharedFromThis;
+
+template <typename T, typename Policy>
+class ObserverList;
+
+template <typename T, typename Policy>
+class SharedPtrVector;
+
+template <typename T, typename Policy>
+class WeakPtrSet;
+
+// Only two raw pointers, neither of them points back at the smart pointer itself
+template <typename T, typename Policy>
+inline constexpr bool kIsTriviallyRelocatable<SharedPtr<T, Policy>> = true;
+
+template <typename T, typename Policy>
+inline constexpr bool kIsTriviallyRelocatable<WeakPtr<T, Policy>> = true;
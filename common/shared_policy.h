@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>  // size_t
+
+// Threading policies: the reference counter control blocks are built from.
+
+// Plain counter, `SharedPtr`s to one object must stay on one thread
+struct SingleThreaded {
+    class Counter {
+    public:
+        constexpr explicit Counter(size_t value) : value_(value){};
+
+        void Increment() {
+            ++value_;
+        }
+        // Returns the new value
+        size_t Decrement() {
+            return --value_;
+        }
+        // Bulk versions for `SharedPtrVector` and friends
+        void Add(size_t count) {
+            value_ += count;
+        }
+        size_t Subtract(size_t count) {
+            return value_ -= count;
+        }
+        // `WeakPtr::Lock()`: never resurrects a dead object
+        bool IncrementIfNonZero() {
+            if (value_ == 0) {
+                return false;
+            }
+            ++value_;
+            return true;
+        }
+        size_t Load() const {
+            return value_;
+        }
+
+    private:
+        size_t value_;
+    };
+};
+
+// Atomic counter, copies of one `SharedPtr` may live on different threads
+struct MultiThreaded {
+    class Counter {
+    public:
+        constexpr explicit Counter(size_t value) : value_(value){};
+
+        void Increment() {
+            value_.fetch_add(1, std::memory_order_relaxed);
+        }
+        // Returns the new value; acq_rel so the last owner sees every write to the object
+        size_t Decrement() {
+            return value_.fetch_sub(1, std::memory_order_acq_rel) - 1;
+        }
+        void Add(size_t count) {
+            value_.fetch_add(count, std::memory_order_relaxed);
+        }
+        size_t Subtract(size_t count) {
+            return value_.fetch_sub(count, std::memory_order_acq_rel) - count;
+        }
+        bool IncrementIfNonZero() {
+            size_t value = value_.load(std::memory_order_relaxed);
+            while (value != 0) {
+                if (value_.compare_exchange_weak(value, value + 1, std::memory_order_acq_rel,
+                                                 std::memory_order_relaxed)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        size_t Load() const {
+            return value_.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::atomic<size_t> value_;
+    };
+};
+
+enum class WeakSupport { kOff, kOn };
+
+enum class SharedFromThisSupport { kOff, kOn };
+
+// `WeakPtr::OnExpire`, costs one pointer per control block
+enum class ExpiryHookSupport { kOff, kOn };
+
+// Compile-time configuration of `SharedPtr` / `WeakPtr` / `EnableSharedFromThis`.
+// Without weak support control blocks carry no weak counter and `WeakPtr` can't be used.
+template <typename Threading, WeakSupport Weak, SharedFromThisSupport FromThis,
+          ExpiryHookSupport Hooks = ExpiryHookSupport::kOff>
+struct SharedPolicy {
+    using Counter = typename Threading::Counter;
+
+    static constexpr bool kWeakSupport = Weak == WeakSupport::kOn;
+    static constexpr bool kSharedFromThisSupport = FromThis == SharedFromThisSupport::kOn;
+    static constexpr bool kExpiryHooks = Hooks == ExpiryHookSupport::kOn;
+
+    static_assert(kWeakSupport || !kSharedFromThisSupport,
+                  "EnableSharedFromThis is built on top of WeakPtr");
+    static_assert(kWeakSupport || !kExpiryHooks, "Expiry hooks are registered through WeakPtr");
+};
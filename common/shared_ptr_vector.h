@@ -0,0 +1,171 @@
+#pragma once
+
+// Include after the directory's `shared.h`, it provides `DefaultSharedPolicy`.
+
+#include <common/shared_core.h>
+
+#include <cstddef>  // size_t
+#include <span>
+#include <utility>
+#include <vector>
+
+// Like `std::vector<SharedPtr<T>>`, but object pointers and control blocks are kept in
+// separate arrays: walking the objects reads only `T*`s, twice as many per cache line.
+// Copying and destroying the whole vector touch the counters once per run of equal
+// adjacent blocks (`IncreaseStrongCounterBy`), so fan-out copies of one pointer are cheap.
+template <typename T, typename Policy = DefaultSharedPolicy>
+class SharedPtrVector {
+    using ControlBlock = ControlBlockOf<Policy>;
+
+public:
+    SharedPtrVector() = default;
+
+    // `count` copies of `ptr`, one counter operation
+    SharedPtrVector(size_t count, const SharedPtr<T, Policy>& ptr)
+        : objects_(count, ptr.observed_ptr_), blocks_(count, ptr.base_block_) {
+        Retain(blocks_);
+    }
+
+    SharedPtrVector(const SharedPtrVector& other)
+        : objects_(other.objects_), blocks_(other.blocks_) {
+        Retain(blocks_);
+    }
+
+    SharedPtrVector(SharedPtrVector&& other) noexcept
+        : objects_(std::move(other.objects_)), blocks_(std::move(other.blocks_)) {
+        other.objects_.clear();
+        other.blocks_.clear();
+    }
+
+    SharedPtrVector& operator=(const SharedPtrVector& other) {
+        if (this != &other) {
+            SharedPtrVector(other).Swap(*this);
+        }
+        return *this;
+    }
+
+    SharedPtrVector& operator=(SharedPtrVector&& other) noexcept {
+        if (this != &other) {
+            SharedPtrVector(std::move(other)).Swap(*this);
+        }
+        return *this;
+    }
+
+    ~SharedPtrVector() {
+        Release(blocks_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    // Takes over the reference of `ptr`
+    void PushBack(SharedPtr<T, Policy> ptr) {
+        objects_.push_back(ptr.observed_ptr_);
+        try {
+            blocks_.push_back(ptr.base_block_);
+        } catch (...) {
+            objects_.pop_back();
+            throw;
+        }
+        ptr.base_block_ = EmptyControlBlock();
+        ptr.observed_ptr_ = nullptr;
+    }
+
+    void PopBack() {
+        ControlBlock* block = blocks_.back();
+        objects_.pop_back();
+        blocks_.pop_back();
+        if (HasControlBlock(block)) {
+            block->DecreaseStrongCounter();
+        }
+    }
+
+    // The arrays are emptied before any object dies, its destructor sees an empty vector
+    void Clear() {
+        std::vector<ControlBlock*> blocks = std::move(blocks_);
+        blocks_.clear();
+        objects_.clear();
+        Release(blocks);
+    }
+
+    void Reserve(size_t capacity) {
+        objects_.reserve(capacity);
+        blocks_.reserve(capacity);
+    }
+
+    void Swap(SharedPtrVector& other) noexcept {
+        objects_.swap(other.objects_);
+        blocks_.swap(other.blocks_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Access
+
+    T* Get(size_t index) const {
+        return objects_[index];
+    }
+    T& operator[](size_t index) const {
+        return *objects_[index];
+    }
+
+    // Owning copy of one element
+    SharedPtr<T, Policy> Share(size_t index) const {
+        SharedPtr<T, Policy> ptr;
+        if (HasControlBlock(blocks_[index])) {
+            blocks_[index]->IncreaseStrongCounter();
+        }
+        ptr.SetBlockPtr(blocks_[index]);
+        ptr.SetObservedPtr(objects_[index]);
+        return ptr;
+    }
+
+    // Iteration over `T*`, the control blocks stay out of the cache
+    std::span<T* const> Objects() const {
+        return objects_;
+    }
+    auto begin() const {
+        return objects_.cbegin();
+    }
+    auto end() const {
+        return objects_.cend();
+    }
+
+    size_t Size() const {
+        return objects_.size();
+    }
+    bool Empty() const {
+        return objects_.empty();
+    }
+
+private:
+    // One counter operation per run of equal adjacent blocks
+
+    static void Retain(std::span<ControlBlock* const> blocks) {
+        for (size_t i = 0, run_end; i < blocks.size(); i = run_end) {
+            run_end = RunEnd(blocks, i);
+            if (HasControlBlock(blocks[i])) {
+                blocks[i]->IncreaseStrongCounterBy(run_end - i);
+            }
+        }
+    }
+
+    static void Release(std::span<ControlBlock* const> blocks) {
+        for (size_t i = 0, run_end; i < blocks.size(); i = run_end) {
+            run_end = RunEnd(blocks, i);
+            if (HasControlBlock(blocks[i])) {
+                blocks[i]->DecreaseStrongCounterBy(run_end - i);
+            }
+        }
+    }
+
+    static size_t RunEnd(std::span<ControlBlock* const> blocks, size_t begin) {
+        size_t end = begin + 1;
+        while (end < blocks.size() && blocks[end] == blocks[begin]) {
+            ++end;
+        }
+        return end;
+    }
+
+    std::vector<T*> objects_;
+    std::vector<ControlBlock*> blocks_;
+};
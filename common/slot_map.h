@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cstddef>  // size_t
+#include <cstdint>  // std::uint32_t, std::uint64_t
+#include <exception>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+// 32-bit slot index and 32-bit generation. A handle is checked by comparing its
+// generation with the slot's: one load from a flat array, no control block.
+struct SlotHandle {
+    uint32_t index = 0;
+    // Odd while the slot is occupied, so the default handle is never valid
+    uint32_t generation = 0;
+
+    uint64_t Bits() const {
+        return (uint64_t{generation} << 32) | index;
+    }
+    static SlotHandle FromBits(uint64_t bits) {
+        return SlotHandle{static_cast<uint32_t>(bits), static_cast<uint32_t>(bits >> 32)};
+    }
+
+    bool operator==(const SlotHandle&) const = default;
+};
+
+// `Insert` / `Erase` while a `SlotMap` borrow is alive
+class SlotMapBorrowed : public std::exception {};
+
+template <typename T>
+class SlotMap;
+
+// Result of `SlotMap::Lock`, like `WeakPtr::Lock()` but without any refcounting:
+// the map refuses to insert or erase while a borrow is alive, so the element stays put.
+template <typename T>
+class SlotBorrow {
+public:
+    SlotBorrow(const SlotBorrow&) = delete;
+    SlotBorrow& operator=(const SlotBorrow&) = delete;
+
+    SlotBorrow(SlotBorrow&& other) noexcept
+        : map_(std::exchange(other.map_, nullptr)), value_(std::exchange(other.value_, nullptr)) {
+    }
+
+    ~SlotBorrow() {
+        if (map_) {
+            --map_->borrows_;
+        }
+    }
+
+    T* Get() const {
+        return value_;
+    }
+    T& operator*() const {
+        return *value_;
+    }
+    T* operator->() const {
+        return value_;
+    }
+    explicit operator bool() const {
+        return value_ != nullptr;
+    }
+
+private:
+    friend class SlotMap<T>;
+
+    SlotBorrow(SlotMap<T>* map, T* value) : map_(value ? map : nullptr), value_(value) {
+        if (map_) {
+            ++map_->borrows_;
+        }
+    }
+
+    SlotMap<T>* map_;
+    T* value_;
+};
+
+// Generational slot map: values are packed densely (erase moves the last one into the
+// hole), slots map stable handles to dense positions. Insert, erase and lookup are O(1),
+// iteration is a walk over a plain array. A slot whose generation is about to wrap
+// is retired, so an old handle never matches a new value.
+template <typename T>
+class SlotMap {
+public:
+    SlotMap() = default;
+
+    SlotMap(const SlotMap&) = delete;
+    SlotMap& operator=(const SlotMap&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    template <typename... Args>
+    SlotHandle Emplace(Args&&... args) {
+        CheckNotBorrowed();
+        // Everything that may throw comes before the free list is touched,
+        // and is undone in reverse order if it does
+        bool reuse = free_head_ != kNone;
+        uint32_t index = reuse ? free_head_ : static_cast<uint32_t>(slots_.size());
+        if (!reuse) {
+            slots_.push_back(Slot{0, 0});
+        }
+        try {
+            dense_to_slot_.push_back(index);
+            try {
+                values_.emplace_back(std::forward<Args>(args)...);
+            } catch (...) {
+                dense_to_slot_.pop_back();
+                throw;
+            }
+        } catch (...) {
+            if (!reuse) {
+                slots_.pop_back();
+            }
+            throw;
+        }
+        if (reuse) {
+            free_head_ = slots_[index].dense_or_next;
+        }
+        ++slots_[index].generation;
+        slots_[index].dense_or_next = static_cast<uint32_t>(values_.size() - 1);
+        return SlotHandle{index, slots_[index].generation};
+    }
+
+    SlotHandle Insert(T value) {
+        return Emplace(std::move(value));
+    }
+
+    bool Erase(SlotHandle handle) {
+        CheckNotBorrowed();
+        if (!Contains(handle)) {
+            return false;
+        }
+        uint32_t dense = slots_[handle.index].dense_or_next;
+        if (dense + 1 != values_.size()) {
+            values_[dense] = std::move(values_.back());
+            dense_to_slot_[dense] = dense_to_slot_.back();
+            slots_[dense_to_slot_[dense]].dense_or_next = dense;
+        }
+        values_.pop_back();
+        dense_to_slot_.pop_back();
+        Release(handle.index);
+        return true;
+    }
+
+    void Clear() {
+        CheckNotBorrowed();
+        for (uint32_t index : dense_to_slot_) {
+            Release(index);
+        }
+        values_.clear();
+        dense_to_slot_.clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Lookup
+
+    bool Contains(SlotHandle handle) const {
+        return handle.index < slots_.size() && slots_[handle.index].generation == handle.generation &&
+               (handle.generation & 1) != 0;
+    }
+
+    T* Find(SlotHandle handle) {
+        return Contains(handle) ? &values_[slots_[handle.index].dense_or_next] : nullptr;
+    }
+    const T* Find(SlotHandle handle) const {
+        return Contains(handle) ? &values_[slots_[handle.index].dense_or_next] : nullptr;
+    }
+
+    // Empty borrow if the value is gone
+    SlotBorrow<T> Lock(SlotHandle handle) {
+        return SlotBorrow<T>(this, Find(handle));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Iteration
+
+    // Dense storage, in no particular order
+    std::span<T> Values() {
+        return values_;
+    }
+    std::span<const T> Values() const {
+        return values_;
+    }
+
+    // `fn(handle, value)` for every value
+    template <typename Fn>
+    void ForEach(Fn&& fn) {
+        for (size_t i = 0; i < values_.size(); ++i) {
+            uint32_t index = dense_to_slot_[i];
+            fn(SlotHandle{index, slots_[index].generation}, values_[i]);
+        }
+    }
+
+    size_t Size() const {
+        return values_.size();
+    }
+    bool Empty() const {
+        return values_.empty();
+    }
+
+private:
+    friend class SlotBorrow<T>;
+
+    static constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+    static constexpr uint32_t kLastGeneration = std::numeric_limits<uint32_t>::max() - 1;
+
+    // Occupied: position in `values_`; free: next free slot
+    struct Slot {
+        uint32_t dense_or_next;
+        uint32_t generation;
+    };
+
+    void CheckNotBorrowed() const {
+        if (borrows_ != 0) {
+            throw SlotMapBorrowed();
+        }
+    }
+
+    // Invalidates the slot's handles and makes it reusable
+    void Release(uint32_t index) {
+        Slot& slot = slots_[index];
+        ++slot.generation;
+        if (slot.generation != kLastGeneration) {
+            slot.dense_or_next = free_head_;
+            free_head_ = index;
+        }
+    }
+
+    std::vector<T> values_;
+    std::vector<uint32_t> dense_to_slot_;
+    std::vector<Slot> slots_;
+    uint32_t free_head_ = kNone;
+    size_t borrows_ = 0;
+};
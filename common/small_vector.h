@@ -0,0 +1,249 @@
+#pragma once
+
+#include <common/relocation.h>
+
+#include <cstddef>  // size_t
+#include <cstring>  // std::memcpy
+#include <memory>   // std::allocator, std::uninitialized_move, std::destroy_n
+#include <new>      // placement new
+#include <type_traits>
+#include <utility>
+
+// Vector with room for `N` elements inside the object itself.
+// Growing moves elements with `memcpy` when `kIsTriviallyRelocatable<T>`,
+// so e.g. a vector of `SharedPtr` reallocates without touching any counter.
+template <typename T, size_t N = 8>
+class SmallVector {
+    static_assert(N > 0, "Use a plain std::vector without inline storage");
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    SmallVector() = default;
+
+    SmallVector(const SmallVector& other) {
+        Reserve(other.size_);
+        try {
+            std::uninitialized_copy(other.begin(), other.end(), data_);
+        } catch (...) {
+            ReleaseHeap();
+            throw;
+        }
+        size_ = other.size_;
+    }
+
+    SmallVector(SmallVector&& other) noexcept(std::is_nothrow_move_constructible_v<T> ||
+                                              kIsTriviallyRelocatable<T>) {
+        StealFrom(other);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) {
+            Clear();
+            Reserve(other.size_);
+            std::uninitialized_copy(other.begin(), other.end(), data_);
+            size_ = other.size_;
+        }
+        return *this;
+    }
+
+    SmallVector& operator=(SmallVector&& other) noexcept(std::is_nothrow_move_constructible_v<T> ||
+                                                         kIsTriviallyRelocatable<T>) {
+        if (this != &other) {
+            Clear();
+            ReleaseHeap();
+            data_ = InlineData();
+            capacity_ = N;
+            StealFrom(other);
+        }
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~SmallVector() {
+        Clear();
+        ReleaseHeap();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void PushBack(const T& value) {
+        EmplaceBack(value);
+    }
+    void PushBack(T&& value) {
+        EmplaceBack(std::move(value));
+    }
+
+    template <typename... Args>
+    T& EmplaceBack(Args&&... args) {
+        if (size_ == capacity_) {
+            return GrowAndEmplaceBack(std::forward<Args>(args)...);
+        }
+        T* slot = new (data_ + size_) T(std::forward<Args>(args)...);
+        ++size_;
+        return *slot;
+    }
+
+    void PopBack() {
+        --size_;
+        data_[size_].~T();
+    }
+
+    void Clear() {
+        std::destroy_n(data_, size_);
+        size_ = 0;
+    }
+
+    void Reserve(size_t capacity) {
+        if (capacity <= capacity_) {
+            return;
+        }
+        T* new_data = Allocate(capacity);
+        try {
+            Relocate(data_, size_, new_data);
+        } catch (...) {
+            Deallocate(new_data, capacity);
+            throw;
+        }
+        ReleaseHeap();
+        data_ = new_data;
+        capacity_ = capacity;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    size_t Size() const {
+        return size_;
+    }
+    size_t Capacity() const {
+        return capacity_;
+    }
+    bool Empty() const {
+        return size_ == 0;
+    }
+    // Elements still live in the object itself
+    bool IsInline() const {
+        return data_ == InlineData();
+    }
+
+    T& operator[](size_t i) {
+        return data_[i];
+    }
+    const T& operator[](size_t i) const {
+        return data_[i];
+    }
+    T& Back() {
+        return data_[size_ - 1];
+    }
+    const T& Back() const {
+        return data_[size_ - 1];
+    }
+
+    T* Data() {
+        return data_;
+    }
+    const T* Data() const {
+        return data_;
+    }
+    T* begin() {
+        return data_;
+    }
+    T* end() {
+        return data_ + size_;
+    }
+    const T* begin() const {
+        return data_;
+    }
+    const T* end() const {
+        return data_ + size_;
+    }
+
+private:
+    // Moves `count` elements to uninitialized `to` and ends their lifetime at `from`.
+    // Falls back to copying for types whose move may throw, `from` stays intact then.
+    static void Relocate(T* from, size_t count, T* to) {
+        if constexpr (kIsTriviallyRelocatable<T>) {
+            if (count != 0) {
+                std::memcpy(static_cast<void*>(to), static_cast<const void*>(from),
+                            count * sizeof(T));
+            }
+        } else {
+            if constexpr (std::is_nothrow_move_constructible_v<T> ||
+                          !std::is_copy_constructible_v<T>) {
+                std::uninitialized_move(from, from + count, to);
+            } else {
+                std::uninitialized_copy(from, from + count, to);
+            }
+            std::destroy_n(from, count);
+        }
+    }
+
+    // Constructs the new element before relocating, `args` may refer to an element of `*this`
+    template <typename... Args>
+    T& GrowAndEmplaceBack(Args&&... args) {
+        size_t new_capacity = capacity_ * 2;
+        T* new_data = Allocate(new_capacity);
+        T* slot = nullptr;
+        try {
+            slot = new (new_data + size_) T(std::forward<Args>(args)...);
+            Relocate(data_, size_, new_data);
+        } catch (...) {
+            if (slot) {
+                slot->~T();
+            }
+            Deallocate(new_data, new_capacity);
+            throw;
+        }
+        ReleaseHeap();
+        data_ = new_data;
+        capacity_ = new_capacity;
+        ++size_;
+        return *slot;
+    }
+
+    // `other` is left empty and inline
+    void StealFrom(SmallVector& other) {
+        if (other.IsInline()) {
+            Relocate(other.data_, other.size_, data_);
+        } else {
+            data_ = other.data_;
+            capacity_ = other.capacity_;
+            other.data_ = other.InlineData();
+            other.capacity_ = N;
+        }
+        size_ = other.size_;
+        other.size_ = 0;
+    }
+
+    static T* Allocate(size_t capacity) {
+        return std::allocator<T>().allocate(capacity);
+    }
+    static void Deallocate(T* data, size_t capacity) {
+        std::allocator<T>().deallocate(data, capacity);
+    }
+    void ReleaseHeap() {
+        if (!IsInline()) {
+            Deallocate(data_, capacity_);
+        }
+    }
+
+    T* InlineData() {
+        return reinterpret_cast<T*>(inline_buffer_);
+    }
+    const T* InlineData() const {
+        return reinterpret_cast<const T*>(inline_buffer_);
+    }
+
+    alignas(T) std::byte inline_buffer_[N * sizeof(T)];
+    T* data_ = InlineData();
+    size_t size_ = 0;
+    size_t capacity_ = N;
+};
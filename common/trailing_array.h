@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>  // std::size_t
+#include <memory>   // std::destroy_n
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>  // std::forward
+
+// Marker base, lets allocation helpers detect objects with a trailing array
+// (same trick as `EnableSharedFromThisBase`).
+class TrailingArrayBase {};
+
+struct TrailingArrayAccess;
+
+// Mixin for "header + N elements in one block" objects.
+// Elements live right after `Derived` in the same allocation; create such objects
+// with `MakeSharedWithTrailing` / `MakeIntrusiveWithTrailing`.
+// An object created with plain `new` simply has an empty trailing array.
+template <typename Derived, typename Elem>
+class TrailingArray : public TrailingArrayBase {
+public:
+    using TrailingHeader = Derived;
+    using TrailingElement = Elem;
+
+    TrailingArray() = default;
+
+    // Trailing storage belongs to the allocation, not to the value: copies start empty.
+    TrailingArray(const TrailingArray&) : trailing_size_(0){};
+
+    TrailingArray& operator=(const TrailingArray&) {
+        return *this;
+    }
+
+    ~TrailingArray() = default;
+
+    std::span<Elem> Trailing() noexcept {
+        return std::span<Elem>(TrailingData(), trailing_size_);
+    }
+
+    std::span<const Elem> Trailing() const noexcept {
+        return std::span<const Elem>(TrailingData(), trailing_size_);
+    }
+
+    // Offset of the first element from the beginning of `Derived`.
+    static constexpr size_t TrailingOffset() {
+        return (sizeof(Derived) + alignof(Elem) - 1) / alignof(Elem) * alignof(Elem);
+    }
+
+private:
+    friend struct TrailingArrayAccess;
+
+    Elem* TrailingData() const noexcept {
+        const char* base = reinterpret_cast<const char*>(static_cast<const Derived*>(this));
+        return std::launder(reinterpret_cast<Elem*>(const_cast<char*>(base) + TrailingOffset()));
+    }
+
+    size_t trailing_size_ = 0;
+};
+
+template <typename T>
+inline constexpr bool kHasTrailingArray = std::is_convertible_v<T*, TrailingArrayBase*>;
+
+struct TrailingArrayAccess {
+    // Bytes needed for `T` followed by `n` elements.
+    template <typename T>
+    static constexpr size_t AllocationSize(size_t n) {
+        static_assert(std::is_same_v<typename T::TrailingHeader, T>,
+                      "Elements follow the class that derives from TrailingArray directly");
+        return T::TrailingOffset() + n * sizeof(typename T::TrailingElement);
+    }
+
+    // Value-initializes `n` elements after an already constructed `object`, or
+    // default-initializes them without `kValueInit` (trivial elements are left as they are).
+    // Rolls back the constructed prefix if an element constructor throws.
+    template <typename T, bool kValueInit = true>
+    static void ConstructElements(T* object, size_t n) {
+        using Elem = typename T::TrailingElement;
+        auto& array = static_cast<TrailingArray<typename T::TrailingHeader, Elem>&>(*object);
+        Elem* data = array.TrailingData();
+        size_t constructed = 0;
+        try {
+            for (; constructed < n; ++constructed) {
+                if constexpr (kValueInit) {
+                    new (data + constructed) Elem();
+                } else {
+                    new (data + constructed) Elem;
+                }
+            }
+        } catch (...) {
+            std::destroy_n(data, constructed);
+            throw;
+        }
+        array.trailing_size_ = n;
+    }
+
+    template <typename T>
+    static void DestroyElements(T* object) {
+        using Elem = typename T::TrailingElement;
+        auto& array = static_cast<TrailingArray<typename T::TrailingHeader, Elem>&>(*object);
+        std::destroy_n(array.TrailingData(), array.trailing_size_);
+        array.trailing_size_ = 0;
+    }
+
+    // Allocates and constructs a standalone `T` with `n` trailing elements.
+    template <typename T, typename... Args>
+    static T* Create(size_t n, Args&&... args) {
+        static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__ &&
+                          alignof(typename T::TrailingElement) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+                      "Over-aligned trailing objects are not supported");
+        void* raw = ::operator new(AllocationSize<T>(n));
+        T* object = nullptr;
+        try {
+            object = new (raw) T(std::forward<Args>(args)...);
+            ConstructElements(object, n);
+        } catch (...) {
+            if (object) {
+                object->~T();
+            }
+            ::operator delete(raw);
+            throw;
+        }
+        return object;
+    }
+
+    // Counterpart of `Create`, also fine for objects created by plain `new`.
+    template <typename T>
+    static void Delete(T* object) {
+        DestroyElements(object);
+        object->~T();
+        ::operator delete(static_cast<void*>(object));
+    }
+};
@@ -0,0 +1,201 @@
+#pragma once
+
+// Include after the directory's `weak.h`, it provides `DefaultSharedPolicy`.
+
+#include <common/weak_core.h>
+
+#include <algorithm>   // std::max
+#include <cstddef>     // size_t
+#include <deque>
+#include <functional>  // std::hash
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct WeakCacheStats {
+    size_t hits = 0;
+    // Found in the weak tier while still alive elsewhere: a reload avoided
+    size_t resurrections = 0;
+    size_t misses = 0;
+};
+
+// Two-tier cache. Recently used values are held by `SharedPtr` in an LRU list limited
+// by a memory budget; evicted values are demoted to `WeakPtr`s, so an object still
+// held by someone else is found again with `Lock()` instead of being reloaded.
+//
+// Keys are spread over shards, each with its own mutex and `budget / shards` bytes.
+// With several threads the values must use `MultiThreaded` counters, otherwise
+// keep the cache to one thread.
+template <typename K, typename V, typename Policy = DefaultSharedPolicy, typename Hash = std::hash<K>>
+class WeakCache {
+    static_assert(Policy::kWeakSupport, "The second tier is WeakPtr");
+
+public:
+    // A `shard_count` of 0 means one shard
+    explicit WeakCache(size_t memory_budget, size_t shard_count = 16)
+        : shard_count_(std::max<size_t>(shard_count, 1)), shards_(shard_count_) {
+        for (Shard& shard : shards_) {
+            shard.budget = memory_budget / shard_count_;
+        }
+    }
+
+    WeakCache(const WeakCache&) = delete;
+    WeakCache& operator=(const WeakCache&) = delete;
+
+    // Empty if `key` is unknown or its value died after demotion
+    SharedPtr<V, Policy> Get(const K& key) {
+        Shard& shard = ShardFor(key);
+        std::vector<SharedPtr<V, Policy>> evicted;
+        SharedPtr<V, Policy> value;
+        {
+            std::lock_guard lock(shard.mutex);
+            if (auto it = shard.strong_index.find(key); it != shard.strong_index.end()) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                ++shard.stats.hits;
+                return it->second->value;
+            }
+            auto it = shard.weak_index.find(key);
+            if (it == shard.weak_index.end()) {
+                ++shard.stats.misses;
+                return value;
+            }
+            value = it->second.value.Lock();
+            size_t cost = it->second.cost;
+            shard.weak_index.erase(it);
+            if (!value) {
+                ++shard.stats.misses;
+                return value;
+            }
+            ++shard.stats.resurrections;
+            InsertStrong(shard, key, value, cost, evicted);
+        }
+        return value;
+    }
+
+    // `cost` is what the value counts against the memory budget
+    void Put(const K& key, SharedPtr<V, Policy> value, size_t cost = sizeof(V)) {
+        Shard& shard = ShardFor(key);
+        std::vector<SharedPtr<V, Policy>> evicted;
+        std::lock_guard lock(shard.mutex);
+        if (auto it = shard.strong_index.find(key); it != shard.strong_index.end()) {
+            shard.used -= it->second->cost;
+            evicted.push_back(std::move(it->second->value));
+            shard.lru.erase(it->second);
+            shard.strong_index.erase(it);
+        }
+        shard.weak_index.erase(key);
+        InsertStrong(shard, key, std::move(value), cost, evicted);
+    }
+
+    // `load()` returns `SharedPtr<V, Policy>` and runs without any lock held,
+    // so two threads missing the same key at once may both load it.
+    template <typename Loader>
+    SharedPtr<V, Policy> GetOrLoad(const K& key, Loader&& load, size_t cost = sizeof(V)) {
+        if (SharedPtr<V, Policy> value = Get(key)) {
+            return value;
+        }
+        SharedPtr<V, Policy> value = load();
+        Put(key, value, cost);
+        return value;
+    }
+
+    bool Erase(const K& key) {
+        Shard& shard = ShardFor(key);
+        SharedPtr<V, Policy> erased;
+        std::lock_guard lock(shard.mutex);
+        if (auto it = shard.strong_index.find(key); it != shard.strong_index.end()) {
+            shard.used -= it->second->cost;
+            erased = std::move(it->second->value);
+            shard.lru.erase(it->second);
+            shard.strong_index.erase(it);
+            return true;
+        }
+        return shard.weak_index.erase(key) != 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    WeakCacheStats Stats() const {
+        WeakCacheStats total;
+        for (size_t i = 0; i < shard_count_; ++i) {
+            std::lock_guard lock(shards_[i].mutex);
+            total.hits += shards_[i].stats.hits;
+            total.resurrections += shards_[i].stats.resurrections;
+            total.misses += shards_[i].stats.misses;
+        }
+        return total;
+    }
+
+    // Sum of costs of the values held strongly
+    size_t MemoryUsage() const {
+        size_t used = 0;
+        for (size_t i = 0; i < shard_count_; ++i) {
+            std::lock_guard lock(shards_[i].mutex);
+            used += shards_[i].used;
+        }
+        return used;
+    }
+
+    size_t StrongSize() const {
+        size_t size = 0;
+        for (size_t i = 0; i < shard_count_; ++i) {
+            std::lock_guard lock(shards_[i].mutex);
+            size += shards_[i].lru.size();
+        }
+        return size;
+    }
+
+private:
+    struct StrongEntry {
+        K key;
+        SharedPtr<V, Policy> value;
+        size_t cost;
+    };
+
+    struct WeakEntry {
+        WeakPtr<V, Policy> value;
+        size_t cost;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<StrongEntry> lru;
+        std::unordered_map<K, typename std::list<StrongEntry>::iterator, Hash> strong_index;
+        std::unordered_map<K, WeakEntry, Hash> weak_index;
+        size_t used = 0;
+        size_t budget = 0;
+        WeakCacheStats stats;
+    };
+
+    // Values leaving the strong tier are released by the caller after unlocking,
+    // so their destructors never run under the shard mutex.
+    static void InsertStrong(Shard& shard, const K& key, SharedPtr<V, Policy> value, size_t cost,
+                             std::vector<SharedPtr<V, Policy>>& evicted) {
+        shard.lru.push_front(StrongEntry{key, std::move(value), cost});
+        shard.strong_index[key] = shard.lru.begin();
+        shard.used += cost;
+        while (shard.used > shard.budget && shard.lru.size() > 1) {
+            StrongEntry& victim = shard.lru.back();
+            shard.weak_index[victim.key] = WeakEntry{WeakPtr<V, Policy>(victim.value), victim.cost};
+            shard.used -= victim.cost;
+            shard.strong_index.erase(victim.key);
+            evicted.push_back(std::move(victim.value));
+            shard.lru.pop_back();
+        }
+        // Dead weak entries only cost memory; drop them once they outnumber live ones
+        if (shard.weak_index.size() > 2 * shard.lru.size() + 16) {
+            std::erase_if(shard.weak_index, [](const auto& item) { return item.second.value.Expired(); });
+        }
+    }
+
+    Shard& ShardFor(const K& key) {
+        return shards_[Hash()(key) % shard_count_];
+    }
+
+    size_t shard_count_;
+    // `Shard` holds a mutex, so it can't be moved: a deque builds the shards in place
+    std::deque<Shard> shards_;
+};
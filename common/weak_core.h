@@ -0,0 +1,278 @@
+#pragma once
+
+// `WeakPtr` and `EnableSharedFromThis` on top of `common/shared_core.h`
+
+#include <common/shared_core.h>
+
+#include <functional>  // std::less, std::function
+#include <utility>
+
+// https://en.cppreference.com/w/cpp/memory/weak_ptr
+template <typename T, typename Policy>
+class WeakPtr {
+    static_assert(Policy::kWeakSupport, "WeakPtr needs a policy with WeakSupport::kOn");
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    WeakPtr() noexcept : base_block_(EmptyControlBlock()), observed_ptr_(nullptr){};
+
+    WeakPtr(const WeakPtr& other) {
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+        if (HasControlBlock(base_block_)) {
+            base_block_->IncreaseWeakCounter();
+        }
+    }
+
+    template <typename Y>
+    WeakPtr(const WeakPtr<Y, Policy>& other) {
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+        if (HasControlBlock(base_block_)) {
+            base_block_->IncreaseWeakCounter();
+        }
+    }
+
+    WeakPtr(WeakPtr&& other) noexcept {
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+        other.base_block_ = EmptyControlBlock();
+        other.observed_ptr_ = nullptr;
+    }
+
+    template <typename Y>
+    WeakPtr(WeakPtr<Y, Policy>&& other) noexcept {
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+        other.base_block_ = EmptyControlBlock();
+        other.observed_ptr_ = nullptr;
+    }
+
+    // Demote `SharedPtr`
+    // #2 from https://en.cppreference.com/w/cpp/memory/weak_ptr/weak_ptr
+    WeakPtr(const SharedPtr<T, Policy>& other) {
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+        if (HasControlBlock(base_block_)) {
+            base_block_->IncreaseWeakCounter();
+        }
+    }
+
+    template <typename Y>
+    WeakPtr(const SharedPtr<Y, Policy>& other) {
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+        if (HasControlBlock(base_block_)) {
+            base_block_->IncreaseWeakCounter();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    template <typename Y>
+    WeakPtr& operator=(const SharedPtr<Y, Policy>& other) {
+        if (HasControlBlock(other.base_block_)) {
+            other.base_block_->IncreaseWeakCounter();
+        }
+        if (HasControlBlock(base_block_)) {
+            base_block_->DecreaseWeakCounter();
+        }
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+        return *this;
+    }
+
+    WeakPtr& operator=(const WeakPtr& other) {
+        if (this != &other) {
+            if (HasControlBlock(other.base_block_)) {
+                other.base_block_->IncreaseWeakCounter();
+            }
+            if (HasControlBlock(base_block_)) {
+                base_block_->DecreaseWeakCounter();
+            }
+            base_block_ = other.base_block_;
+            observed_ptr_ = other.observed_ptr_;
+        }
+        return *this;
+    }
+
+    template <typename Y>
+    WeakPtr& operator=(const WeakPtr<Y, Policy>& other) {
+        if (HasControlBlock(other.base_block_)) {
+            other.base_block_->IncreaseWeakCounter();
+        }
+        if (HasControlBlock(base_block_)) {
+            base_block_->DecreaseWeakCounter();
+        }
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+        return *this;
+    }
+
+    WeakPtr& operator=(WeakPtr&& other) noexcept {
+        if (this != &other) {
+            if (HasControlBlock(base_block_)) {
+                base_block_->DecreaseWeakCounter();
+            }
+            base_block_ = other.base_block_;
+            observed_ptr_ = other.observed_ptr_;
+            other.base_block_ = EmptyControlBlock();
+            other.observed_ptr_ = nullptr;
+        }
+        return *this;
+    }
+
+    template <typename Y>
+    WeakPtr& operator=(WeakPtr<Y, Policy>&& other) noexcept {
+        if (HasControlBlock(base_block_)) {
+            base_block_->DecreaseWeakCounter();
+        }
+        base_block_ = other.base_block_;
+        observed_ptr_ = other.observed_ptr_;
+        other.base_block_ = EmptyControlBlock();
+        other.observed_ptr_ = nullptr;
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~WeakPtr() {
+        if (HasControlBlock(base_block_)) {
+            base_block_->DecreaseWeakCounter();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        if (HasControlBlock(base_block_)) {
+            base_block_->DecreaseWeakCounter();
+        }
+        base_block_ = EmptyControlBlock();
+        observed_ptr_ = nullptr;
+    }
+
+    void Swap(WeakPtr& other) noexcept {
+        std::swap(base_block_, other.base_block_);
+        std::swap(observed_ptr_, other.observed_ptr_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    size_t UseCount() const {
+        if (HasControlBlock(base_block_)) {
+            return base_block_->GetStrongCounter();
+        }
+        return 0;
+    }
+
+    bool Expired() const {
+        return UseCount() == 0;
+    }
+
+    // Owner-based observers, compare control blocks instead of `Get()` (see `common/owner.h`)
+    template <typename Other>
+    bool OwnerBefore(const Other& other) const {
+        return std::less<const void*>()(base_block_, other.base_block_);
+    }
+    template <typename Other>
+    bool OwnerEqual(const Other& other) const {
+        return static_cast<const void*>(base_block_) == static_cast<const void*>(other.base_block_);
+    }
+    size_t OwnerHash() const {
+        return HashBlockPointer(base_block_);
+    }
+
+    // Check and increment in one step, so a racing last `SharedPtr` can't slip in between
+    SharedPtr<T, Policy> Lock() const& {
+        SharedPtr<T, Policy> return_ptr;
+        if (HasControlBlock(base_block_) && base_block_->TryIncreaseStrongCounter()) {
+            return_ptr.SetBlockPtr(base_block_);
+            return_ptr.SetObservedPtr(observed_ptr_);
+        }
+        return return_ptr;
+    }
+
+    // Runs `hook` once, on the thread that releases the last `SharedPtr`, right after the
+    // object is destroyed (so `Lock()` fails inside). Replaces polling `Expired()`.
+    // If the object is already dead `hook` runs here instead and the result is false;
+    // also false, with `hook` dropped, for objects that never die. Hooks must not throw.
+    bool OnExpire(std::function<void()> hook) const {
+        static_assert(Policy::kExpiryHooks, "OnExpire needs ExpiryHookSupport::kOn");
+        if (HasControlBlock(base_block_) && base_block_->AddExpiryHook(hook)) {
+            return true;
+        }
+        if (Expired()) {
+            hook();
+        }
+        return false;
+    }
+
+    // Consumes the `WeakPtr`: `std::move(weak).Lock()` leaves it empty.
+    // Still one strong increment and one weak decrement: a weak reference
+    // can't be turned into a strong one in place.
+    SharedPtr<T, Policy> Lock() && {
+        SharedPtr<T, Policy> return_ptr = std::as_const(*this).Lock();
+        Reset();
+        return return_ptr;
+    }
+
+private:
+    template <typename Y, typename P>
+    friend class WeakPtr;
+    template <typename Y, typename P>
+    friend class SharedPtr;
+    template <typename Y, typename P>
+    friend class EnableSharedFromThis;
+    template <typename Y, typename P>
+    friend class ObserverList;
+    template <typename Y, typename P>
+    friend class WeakPtrSet;
+    WeakControlBlock* base_block_;
+    T* observed_ptr_;
+};
+
+// Look for usage examples in tests and seminar
+template <typename T, typename Policy>
+class EnableSharedFromThis : public EnableSharedFromThisBase {
+    static_assert(Policy::kSharedFromThisSupport,
+                  "EnableSharedFromThis needs a policy with SharedFromThisSupport::kOn");
+
+public:
+    SharedPtr<T, Policy> SharedFromThis() {
+        return weak_this_.Lock();
+    };
+    SharedPtr<const T, Policy> SharedFromThis() const {
+        return weak_this_.Lock();
+    }
+    WeakPtr<T, Policy> WeakFromThis() noexcept {
+        return weak_this_;
+    }
+    WeakPtr<const T, Policy> WeakFromThis() const noexcept {
+        return WeakPtr<const T, Policy>(weak_this_);
+    }
+
+    EnableSharedFromThis() = default;
+
+    // `weak_this_` belongs to the owning block, a copy gets its own on its first owner
+    EnableSharedFromThis(const EnableSharedFromThis&) : EnableSharedFromThisBase() {
+    }
+    EnableSharedFromThis& operator=(const EnableSharedFromThis&) {
+        return *this;
+    }
+
+    // `weak_this_` just drops its weak reference; the strong owners' shared weak
+    // reference keeps the block alive until the object is fully destroyed.
+    ~EnableSharedFromThis() = default;
+
+private:
+    template <typename Y, typename P>
+    friend class SharedPtr;
+    WeakPtr<T, Policy> weak_this_;
+};
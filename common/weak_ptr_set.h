@@ -0,0 +1,167 @@
+#pragma once
+
+// Include after the directory's `weak.h`, it provides `DefaultSharedPolicy`.
+
+#include <common/weak_core.h>
+
+#include <algorithm>  // std::min
+#include <cstddef>    // size_t
+#include <utility>
+#include <vector>
+
+// A large bag of `WeakPtr`s that is locked or swept as a whole, e.g. subscriptions or
+// cache back-references. Entries are not deduplicated.
+//
+// Control blocks are stored contiguously, apart from the object pointers. Every block
+// is a separate allocation, so a naive loop stalls on one cache miss per entry; the bulk
+// operations prefetch blocks `kPrefetchDistance` entries ahead of the one being checked.
+// Strong counts sit behind the virtual `GetStrongCounter` and their layout depends on the
+// block type, so the check itself is a call per entry, not a vector gather.
+template <typename T, typename Policy = DefaultSharedPolicy>
+class WeakPtrSet {
+    static_assert(Policy::kWeakSupport, "Entries are held by WeakPtr");
+
+public:
+    WeakPtrSet() = default;
+
+    WeakPtrSet(const WeakPtrSet&) = delete;
+    WeakPtrSet& operator=(const WeakPtrSet&) = delete;
+
+    WeakPtrSet(WeakPtrSet&&) = default;
+    WeakPtrSet& operator=(WeakPtrSet&& other) {
+        if (this != &other) {
+            Clear();
+            blocks_ = std::move(other.blocks_);
+            objects_ = std::move(other.objects_);
+        }
+        return *this;
+    }
+
+    ~WeakPtrSet() {
+        Clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    // Empty pointers are ignored
+    void Insert(WeakPtr<T, Policy> ptr) {
+        if (!ptr.observed_ptr_) {
+            return;
+        }
+        blocks_.push_back(ptr.base_block_);
+        try {
+            objects_.push_back(ptr.observed_ptr_);
+        } catch (...) {
+            blocks_.pop_back();
+            throw;
+        }
+        // The weak reference now belongs to the set
+        ptr.base_block_ = EmptyControlBlock();
+        ptr.observed_ptr_ = nullptr;
+    }
+
+    // By owner, every entry of it
+    template <typename Ptr>
+    size_t Erase(const Ptr& ptr) {
+        size_t kept = 0;
+        for (size_t i = 0; i < blocks_.size(); ++i) {
+            if (blocks_[i] == ptr.base_block_) {
+                blocks_[i]->DecreaseWeakCounter();
+            } else {
+                blocks_[kept] = blocks_[i];
+                objects_[kept] = objects_[i];
+                ++kept;
+            }
+        }
+        size_t erased = blocks_.size() - kept;
+        blocks_.resize(kept);
+        objects_.resize(kept);
+        return erased;
+    }
+
+    void Clear() {
+        for (WeakControlBlock* block : blocks_) {
+            block->DecreaseWeakCounter();
+        }
+        blocks_.clear();
+        objects_.clear();
+    }
+
+    void Reserve(size_t capacity) {
+        blocks_.reserve(capacity);
+        objects_.reserve(capacity);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Bulk operations
+
+    // Strong pointers to every live entry, in insertion order; dead entries stay until swept
+    std::vector<SharedPtr<T, Policy>> LockAll() const {
+        std::vector<SharedPtr<T, Policy>> locked;
+        locked.reserve(blocks_.size());
+        for (size_t i = 0; i < blocks_.size(); ++i) {
+            Prefetch(i + kPrefetchDistance);
+            if (blocks_[i]->TryIncreaseStrongCounter()) {
+                locked.emplace_back();
+                locked.back().SetBlockPtr(blocks_[i]);
+                locked.back().SetObservedPtr(objects_[i]);
+            }
+        }
+        return locked;
+    }
+
+    // Drops entries whose objects are dead, keeping the order of the rest; returns how many
+    size_t SweepExpired() {
+        // Liveness of a whole batch is read first, so the prefetches of the batch overlap
+        bool alive[kBatchSize];
+        size_t kept = 0;
+        for (size_t begin = 0; begin < blocks_.size(); begin += kBatchSize) {
+            size_t end = std::min(blocks_.size(), begin + kBatchSize);
+            for (size_t i = begin; i < end; ++i) {
+                Prefetch(i + kPrefetchDistance);
+                alive[i - begin] = blocks_[i]->GetStrongCounter() != 0;
+            }
+            for (size_t i = begin; i < end; ++i) {
+                if (alive[i - begin]) {
+                    blocks_[kept] = blocks_[i];
+                    objects_[kept] = objects_[i];
+                    ++kept;
+                } else {
+                    blocks_[i]->DecreaseWeakCounter();
+                }
+            }
+        }
+        size_t swept = blocks_.size() - kept;
+        blocks_.resize(kept);
+        objects_.resize(kept);
+        return swept;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    // Including dead entries not swept yet
+    size_t Size() const {
+        return blocks_.size();
+    }
+    bool Empty() const {
+        return blocks_.empty();
+    }
+
+private:
+    static constexpr size_t kBatchSize = 64;
+    // About as many misses as a core keeps in flight
+    static constexpr size_t kPrefetchDistance = 16;
+
+    void Prefetch(size_t index) const {
+#if defined(__GNUC__) || defined(__clang__)
+        if (index < blocks_.size()) {
+            __builtin_prefetch(blocks_[index]);
+        }
+#endif
+    }
+
+    std::vector<WeakControlBlock*> blocks_;
+    std::vector<T*> objects_;
+};
@@ -1,7 +1,23 @@
 #pragma once
 
-#include <cstddef>  // for std::nullptr_t
+#include <common/relocation.h>
+#include <common/trailing_array.h>
+
+#include <algorithm>   // for std::sort
+#include <cstddef>     // for std::nullptr_t
+#include <cstdint>     // for std::uint32_t
+#include <functional>  // for std::less
+#include <limits>
+#include <span>
 #include <utility>  // for std::exchange / std::swap
+#include <vector>
+
+// Selects the immortal constructor of a counter / `RefCounted`,
+// e.g. for `constinit` singletons that are never destroyed.
+struct ImmortalTag {
+    explicit ImmortalTag() = default;
+};
+inline constexpr ImmortalTag kImmortal{};
 
 class SimpleCounter {
 public:
@@ -13,6 +29,15 @@ public:
         --count_;
         return count_;
     }
+    // `count` references at once, see `RetainAll` / `ReleaseAll`
+    size_t IncRef(size_t count) {
+        count_ += count;
+        return count_;
+    }
+    size_t DecRef(size_t count) {
+        count_ -= count;
+        return count_;
+    }
     size_t RefCount() const {
         return count_;
     }
@@ -21,16 +46,71 @@ private:
     size_t count_ = 0;
 };
 
+// 32-bit counter that saturates instead of overflowing.
+// A saturated counter is immortal: `IncRef`/`DecRef` are no-ops and the object is never destroyed.
+class CompactCounter {
+public:
+    static constexpr uint32_t kSaturated = std::numeric_limits<uint32_t>::max();
+
+    constexpr CompactCounter() = default;
+    constexpr explicit CompactCounter(ImmortalTag) : count_(kSaturated){};
+
+    size_t IncRef() {
+        if (count_ != kSaturated) {
+            ++count_;
+        }
+        return count_;
+    }
+    size_t DecRef() {
+        if (count_ != kSaturated) {
+            --count_;
+        }
+        return count_;
+    }
+    // Saturates if the sum doesn't fit
+    size_t IncRef(size_t count) {
+        if (count_ != kSaturated) {
+            count_ = count < kSaturated - count_ ? static_cast<uint32_t>(count_ + count) : kSaturated;
+        }
+        return count_;
+    }
+    size_t DecRef(size_t count) {
+        if (count_ != kSaturated) {
+            count_ -= static_cast<uint32_t>(count);
+        }
+        return count_;
+    }
+    size_t RefCount() const {
+        return count_;
+    }
+    bool IsImmortal() const {
+        return count_ == kSaturated;
+    }
+
+private:
+    uint32_t count_ = 0;
+};
+
 struct DefaultDelete {
     template <typename T>
     static void Destroy(T* object) {
-        delete object;
+        if constexpr (kHasTrailingArray<T>) {
+            // Also covers objects from `MakeIntrusiveWithTrailing`
+            TrailingArrayAccess::Delete(object);
+        } else {
+            delete object;
+        }
     }
 };
 
 template <typename Derived, typename Counter, typename Deleter>
 class RefCounted {
 public:
+    constexpr RefCounted() = default;
+
+    // Never destroyed, needs a `Counter` with an immortal state (see `CompactCounter`).
+    constexpr explicit RefCounted(ImmortalTag tag) : counter_(tag){};
+
     // Increase reference counter.
     void IncRef() {
         counter_.IncRef();
@@ -39,28 +119,67 @@ public:
     // Decrease reference counter.
     // Destroy object using DefaultDeleter when the last instance dies.
     void DecRef() {
+        if (IsImmortal()) {
+            return;
+        }
         if (counter_.RefCount() == 0) {
-            Deleter::Destroy(static_cast<Derived*>(this));
+            Destroy();
         } else {
             counter_.DecRef();
             if (counter_.RefCount() == 0) {
-                Deleter::Destroy(static_cast<Derived*>(this));
+                Destroy();
             }
         }
     }
 
+    // `count` references at once, needs a `Counter` with counted `IncRef`/`DecRef`.
+    // The object is destroyed at most once, when the counter reaches zero.
+    void IncRef(size_t count)
+        requires requires(Counter& counter) { counter.IncRef(size_t{}); }
+    {
+        counter_.IncRef(count);
+    }
+    void DecRef(size_t count)
+        requires requires(Counter& counter) { counter.DecRef(size_t{}); }
+    {
+        if (IsImmortal()) {
+            return;
+        }
+        if (counter_.DecRef(count) == 0) {
+            Destroy();
+        }
+    }
+
     // Get current counter value (the number of strong references).
     size_t RefCount() const {
         return counter_.RefCount();
     }
 
 private:
+    // Immortal objects return before any `Destroy` path
+    bool IsImmortal() const {
+        if constexpr (requires(const Counter& counter) { counter.IsImmortal(); }) {
+            return counter_.IsImmortal();
+        } else {
+            return false;
+        }
+    }
+
+    // Out of line: the cold path stays out of every `IntrusivePtr` destructor, and GCC
+    // doesn't see a `delete` of a static immortal object (-Wfree-nonheap-object)
+    [[gnu::noinline]] void Destroy() {
+        Deleter::Destroy(static_cast<Derived*>(this));
+    }
+
     Counter counter_;
 };
 
 template <typename Derived, typename D = DefaultDelete>
 using SimpleRefCounted = RefCounted<Derived, SimpleCounter, D>;
 
+template <typename Derived, typename D = DefaultDelete>
+using CompactRefCounted = RefCounted<Derived, CompactCounter, D>;
+
 template <typename T>
 class IntrusivePtr {
     template <typename Y>
@@ -68,8 +187,16 @@ class IntrusivePtr {
 
 public:
     // Constructors
-    IntrusivePtr() : ptr_object_(nullptr){};
-    IntrusivePtr(std::nullptr_t) : ptr_object_(nullptr){};
+    IntrusivePtr() noexcept : ptr_object_(nullptr){};
+
+    // Takes over a reference that is already counted, e.g. one from `Release`
+    static IntrusivePtr Adopt(T* ptr) {
+        IntrusivePtr return_ptr;
+        return_ptr.ptr_object_ = ptr;
+        return return_ptr;
+    }
+
+    IntrusivePtr(std::nullptr_t) noexcept : ptr_object_(nullptr){};
     IntrusivePtr(T* ptr) : ptr_object_(ptr) {
         ptr_object_->IncRef();
     }
@@ -83,7 +210,7 @@ public:
     }
 
     template <typename Y>
-    IntrusivePtr(IntrusivePtr<Y>&& other) {
+    IntrusivePtr(IntrusivePtr<Y>&& other) noexcept {
         ptr_object_ = other.ptr_object_;
         other.ptr_object_ = nullptr;
     }
@@ -94,7 +221,7 @@ public:
             ptr_object_->IncRef();
         }
     }
-    IntrusivePtr(IntrusivePtr&& other) {
+    IntrusivePtr(IntrusivePtr&& other) noexcept {
         ptr_object_ = other.ptr_object_;
         other.ptr_object_ = nullptr;
     }
@@ -112,7 +239,7 @@ public:
         }
         return *this;
     }
-    IntrusivePtr& operator=(IntrusivePtr&& other) {
+    IntrusivePtr& operator=(IntrusivePtr&& other) noexcept {
         if (*this != other) {
             if (ptr_object_) {
                 ptr_object_->DecRef();
@@ -144,7 +271,11 @@ public:
         }
         ptr_object_ = ptr;
     }
-    void Swap(IntrusivePtr& other) {
+    // Gives up the reference without `DecRef`, pair with `Adopt`
+    T* Release() {
+        return std::exchange(ptr_object_, nullptr);
+    }
+    void Swap(IntrusivePtr& other) noexcept {
         std::swap(ptr_object_, other.ptr_object_);
     }
 
@@ -176,7 +307,134 @@ private:
     T* ptr_object_;
 };
 
+template <typename T>
+inline constexpr bool kIsTriviallyRelocatable<IntrusivePtr<T>> = true;
+
+// Casts, rvalue overloads move the reference instead of `IncRef` + `DecRef`.
+// No `ConstPointerCast`: `RefCounted` can't count through a const object.
+
+template <typename T, typename Y>
+IntrusivePtr<T> StaticPointerCast(const IntrusivePtr<Y>& ptr) {
+    return IntrusivePtr<T>(static_cast<T*>(ptr.Get()));
+}
+
+template <typename T, typename Y>
+IntrusivePtr<T> StaticPointerCast(IntrusivePtr<Y>&& ptr) {
+    return IntrusivePtr<T>::Adopt(static_cast<T*>(ptr.Release()));
+}
+
+template <typename T, typename Y>
+IntrusivePtr<T> DynamicPointerCast(const IntrusivePtr<Y>& ptr) {
+    if (T* cast_ptr = dynamic_cast<T*>(ptr.Get())) {
+        return IntrusivePtr<T>(cast_ptr);
+    }
+    return IntrusivePtr<T>();
+}
+
+// `ptr` keeps its reference if the cast fails
+template <typename T, typename Y>
+IntrusivePtr<T> DynamicPointerCast(IntrusivePtr<Y>&& ptr) {
+    if (T* cast_ptr = dynamic_cast<T*>(ptr.Get())) {
+        ptr.Release();
+        return IntrusivePtr<T>::Adopt(cast_ptr);
+    }
+    return IntrusivePtr<T>();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Bulk refcounting: pointers are grouped by object, each distinct object gets one
+// `IncRef(k)` / `DecRef(k)`. Types without counted overloads fall back to `k` single calls.
+
+namespace intrusive_detail {
+
+template <typename T>
+void AddRefs(T* object, size_t count) {
+    if constexpr (requires { object->IncRef(count); }) {
+        object->IncRef(count);
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            object->IncRef();
+        }
+    }
+}
+
+template <typename T>
+void DropRefs(T* object, size_t count) {
+    if constexpr (requires { object->DecRef(count); }) {
+        object->DecRef(count);
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            object->DecRef();
+        }
+    }
+}
+
+// Calls `fn(object, count)` once per distinct object of `objects`, sorts `objects`
+template <typename T, typename Fn>
+void ForEachGroup(std::vector<T*>& objects, Fn fn) {
+    std::sort(objects.begin(), objects.end(), std::less<T*>());
+    for (size_t begin = 0, end; begin < objects.size(); begin = end) {
+        end = begin + 1;
+        while (end < objects.size() && objects[end] == objects[begin]) {
+            ++end;
+        }
+        fn(objects[begin], end - begin);
+    }
+}
+
+}  // namespace intrusive_detail
+
+// Copies of every pointer of `ptrs`
+template <typename T>
+std::vector<IntrusivePtr<T>> RetainAll(std::span<const IntrusivePtr<T>> ptrs) {
+    std::vector<IntrusivePtr<T>> copies;
+    copies.reserve(ptrs.size());
+    std::vector<T*> objects;
+    objects.reserve(ptrs.size());
+    for (const IntrusivePtr<T>& ptr : ptrs) {
+        if (ptr) {
+            objects.push_back(ptr.Get());
+        }
+    }
+    intrusive_detail::ForEachGroup(objects, intrusive_detail::AddRefs<T>);
+    for (const IntrusivePtr<T>& ptr : ptrs) {
+        copies.push_back(IntrusivePtr<T>::Adopt(ptr.Get()));
+    }
+    return copies;
+}
+
+template <typename T>
+std::vector<IntrusivePtr<T>> RetainAll(const std::vector<IntrusivePtr<T>>& ptrs) {
+    return RetainAll(std::span<const IntrusivePtr<T>>(ptrs));
+}
+
+// Resets every pointer of `ptrs`. All of them are empty before the first object dies.
+template <typename T>
+void ReleaseAll(std::span<IntrusivePtr<T>> ptrs) {
+    std::vector<T*> objects;
+    objects.reserve(ptrs.size());
+    for (IntrusivePtr<T>& ptr : ptrs) {
+        if (ptr) {
+            objects.push_back(ptr.Release());
+        }
+    }
+    intrusive_detail::ForEachGroup(objects, intrusive_detail::DropRefs<T>);
+}
+
+template <typename T>
+void ReleaseAll(std::vector<IntrusivePtr<T>>& ptrs) {
+    ReleaseAll(std::span<IntrusivePtr<T>>(ptrs));
+}
+
 template <typename T, typename... Args>
 IntrusivePtr<T> MakeIntrusive(Args&&... args) {
     return IntrusivePtr<T>(reinterpret_cast<T*>(new T(std::forward<Args>(args)...)));
 }
+
+// Header and `n` default-constructed trailing elements in one allocation.
+// `T` derives from `TrailingArray<T, Elem>`, elements are reachable via `Trailing()`.
+template <typename T, typename Elem, typename... Args>
+IntrusivePtr<T> MakeIntrusiveWithTrailing(size_t n, Args&&... args) {
+    static_assert(std::is_base_of_v<TrailingArray<T, Elem>, T>, "T must derive from TrailingArray");
+    return IntrusivePtr<T>(TrailingArrayAccess::Create<T>(n, std::forward<Args>(args)...));
+}
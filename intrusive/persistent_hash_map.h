@@ -0,0 +1,293 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <bit>         // std::popcount
+#include <cstddef>     // size_t
+#include <cstdint>     // std::uint32_t
+#include <functional>  // std::hash, std::equal_to
+#include <limits>
+#include <span>
+#include <utility>
+#include <variant>
+
+// Persistent hash map (HAMT): copies are O(1) snapshots that share all nodes, and
+// changing one version leaves the others intact.
+//
+// Every node covers 5 bits of the hash. A 32-bit bitmap tells which children are present
+// and the slots are packed right after the node (`TrailingArray`), a child's index is the
+// popcount of the bitmap bits below it. Keys whose hashes agree in all bits end up in a
+// collision node with a plain list of entries.
+//
+// Writes copy the path from the root only where it is shared. A node with `RefCount() == 1`
+// under an unshared parent belongs to this version alone and is changed in place, so a
+// series of writes to one version after the first copies nothing (transient mode).
+// Single-threaded: nodes use `SimpleRefCounted`.
+template <typename K, typename V, typename Hash = std::hash<K>, typename Equal = std::equal_to<K>>
+class PersistentHashMap {
+public:
+    PersistentHashMap() = default;
+
+    // Snapshots
+    PersistentHashMap(const PersistentHashMap&) = default;
+    PersistentHashMap(PersistentHashMap&& other) noexcept
+        : root_(std::move(other.root_)), size_(std::exchange(other.size_, 0)) {
+    }
+    PersistentHashMap& operator=(const PersistentHashMap&) = default;
+    PersistentHashMap& operator=(PersistentHashMap&& other) noexcept {
+        root_ = std::move(other.root_);
+        size_ = std::exchange(other.size_, 0);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    // Inserts or overwrites, returns true if `key` is new
+    bool Set(K key, V value) {
+        size_t hash = Hash()(key);
+        if (!root_) {
+            root_ = MakeIntrusiveWithTrailing<Node, Slot>(1, BitFor(hash, 0));
+            root_->Trailing()[0] = Entry(std::move(key), std::move(value));
+            size_ = 1;
+            return true;
+        }
+        bool added = Assign(root_, 0, hash, std::move(key), std::move(value));
+        size_ += added;
+        return added;
+    }
+
+    bool Erase(const K& key) {
+        // Nothing gets copied for a missing key
+        if (!Find(key)) {
+            return false;
+        }
+        Remove(root_, 0, Hash()(key), key);
+        if (root_->Trailing().empty()) {
+            root_.Reset();
+        }
+        --size_;
+        return true;
+    }
+
+    void Clear() {
+        root_.Reset();
+        size_ = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Lookup
+
+    const V* Find(const K& key) const {
+        size_t hash = Hash()(key);
+        const Node* node = root_.Get();
+        for (size_t shift = 0; node; shift += kBits) {
+            if (shift >= kHashBits) {
+                for (const Slot& slot : node->Trailing()) {
+                    const Entry& entry = std::get<Entry>(slot);
+                    if (Equal()(entry.first, key)) {
+                        return &entry.second;
+                    }
+                }
+                return nullptr;
+            }
+            uint32_t bit = BitFor(hash, shift);
+            if (!(node->bitmap & bit)) {
+                return nullptr;
+            }
+            const Slot& slot = node->Trailing()[IndexOf(node->bitmap, bit)];
+            if (const Entry* entry = std::get_if<Entry>(&slot)) {
+                return Equal()(entry->first, key) ? &entry->second : nullptr;
+            }
+            node = std::get<NodePtr>(slot).Get();
+        }
+        return nullptr;
+    }
+
+    bool Contains(const K& key) const {
+        return Find(key) != nullptr;
+    }
+
+    // `fn(key, value)` for every entry, in no particular order
+    template <typename Fn>
+    void ForEach(Fn&& fn) const {
+        if (root_) {
+            Visit(*root_, fn);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    size_t Size() const {
+        return size_;
+    }
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+private:
+    static constexpr size_t kBits = 5;
+    static constexpr size_t kHashBits = std::numeric_limits<size_t>::digits;
+
+    struct Node;
+    using NodePtr = IntrusivePtr<Node>;
+    using Entry = std::pair<K, V>;
+    using Slot = std::variant<NodePtr, Entry>;
+
+    // Collision nodes have an empty bitmap
+    struct Node : SimpleRefCounted<Node>, TrailingArray<Node, Slot> {
+        explicit Node(uint32_t bitmap) : bitmap(bitmap) {
+        }
+
+        uint32_t bitmap;
+    };
+
+    static uint32_t BitFor(size_t hash, size_t shift) {
+        return uint32_t{1} << ((hash >> shift) & 31);
+    }
+
+    static size_t IndexOf(uint32_t bitmap, uint32_t bit) {
+        return std::popcount(bitmap & (bit - 1));
+    }
+
+    // A node this version shares with others is replaced by its copy before any change
+    static void MakeExclusive(NodePtr& node) {
+        if (node->RefCount() > 1) {
+            node = Rebuild(node, node->bitmap, node->Trailing().size(), node->Trailing().size());
+        }
+    }
+
+    // Copy of `node` with `new_size` slots and the slot at `skip` left out (if it exists)
+    // or left default for the caller to fill (if `new_size` is one more). Slots are moved
+    // out of a node nobody else holds.
+    static NodePtr Rebuild(const NodePtr& node, uint32_t bitmap, size_t new_size, size_t skip) {
+        NodePtr result = MakeIntrusiveWithTrailing<Node, Slot>(new_size, bitmap);
+        std::span<Slot> from = node->Trailing();
+        std::span<Slot> to = result->Trailing();
+        bool steal = node->RefCount() == 1;
+        size_t gap = new_size > from.size() ? 1 : 0;
+        for (size_t i = 0, j = 0; i < from.size(); ++i) {
+            if (i == skip && gap == 0) {
+                continue;
+            }
+            if (i == skip) {
+                ++j;
+            }
+            if (steal) {
+                to[j++] = std::move(from[i]);
+            } else {
+                to[j++] = from[i];
+            }
+        }
+        return result;
+    }
+
+    // Subtree holding two entries whose hashes agree below `shift`
+    static NodePtr Branch(size_t shift, Entry first, size_t first_hash, Entry second,
+                          size_t second_hash) {
+        if (shift >= kHashBits) {
+            NodePtr node = MakeIntrusiveWithTrailing<Node, Slot>(2, 0);
+            node->Trailing()[0] = std::move(first);
+            node->Trailing()[1] = std::move(second);
+            return node;
+        }
+        uint32_t first_bit = BitFor(first_hash, shift);
+        uint32_t second_bit = BitFor(second_hash, shift);
+        if (first_bit == second_bit) {
+            NodePtr node = MakeIntrusiveWithTrailing<Node, Slot>(1, first_bit);
+            node->Trailing()[0] = Branch(shift + kBits, std::move(first), first_hash,
+                                         std::move(second), second_hash);
+            return node;
+        }
+        NodePtr node = MakeIntrusiveWithTrailing<Node, Slot>(2, first_bit | second_bit);
+        bool first_goes_first = first_bit < second_bit;
+        node->Trailing()[first_goes_first ? 0 : 1] = std::move(first);
+        node->Trailing()[first_goes_first ? 1 : 0] = std::move(second);
+        return node;
+    }
+
+    static bool Assign(NodePtr& node, size_t shift, size_t hash, K&& key, V&& value) {
+        if (shift >= kHashBits) {
+            std::span<Slot> slots = node->Trailing();
+            for (size_t i = 0; i < slots.size(); ++i) {
+                if (Equal()(std::get<Entry>(slots[i]).first, key)) {
+                    MakeExclusive(node);
+                    std::get<Entry>(node->Trailing()[i]).second = std::move(value);
+                    return false;
+                }
+            }
+            node = Rebuild(node, 0, slots.size() + 1, slots.size());
+            node->Trailing().back() = Entry(std::move(key), std::move(value));
+            return true;
+        }
+
+        uint32_t bit = BitFor(hash, shift);
+        size_t index = IndexOf(node->bitmap, bit);
+        if (!(node->bitmap & bit)) {
+            node = Rebuild(node, node->bitmap | bit, node->Trailing().size() + 1, index);
+            node->Trailing()[index] = Entry(std::move(key), std::move(value));
+            return true;
+        }
+
+        MakeExclusive(node);
+        Slot& slot = node->Trailing()[index];
+        if (NodePtr* child = std::get_if<NodePtr>(&slot)) {
+            return Assign(*child, shift + kBits, hash, std::move(key), std::move(value));
+        }
+        Entry& entry = std::get<Entry>(slot);
+        if (Equal()(entry.first, key)) {
+            entry.second = std::move(value);
+            return false;
+        }
+        size_t entry_hash = Hash()(entry.first);
+        slot = Branch(shift + kBits, std::move(entry), entry_hash, Entry(std::move(key), std::move(value)),
+                      hash);
+        return true;
+    }
+
+    // `key` is known to be present
+    static void Remove(NodePtr& node, size_t shift, size_t hash, const K& key) {
+        if (shift >= kHashBits) {
+            std::span<Slot> slots = node->Trailing();
+            size_t index = 0;
+            while (!Equal()(std::get<Entry>(slots[index]).first, key)) {
+                ++index;
+            }
+            node = Rebuild(node, 0, slots.size() - 1, index);
+            return;
+        }
+
+        uint32_t bit = BitFor(hash, shift);
+        size_t index = IndexOf(node->bitmap, bit);
+        if (std::holds_alternative<Entry>(node->Trailing()[index])) {
+            node = Rebuild(node, node->bitmap & ~bit, node->Trailing().size() - 1, index);
+            return;
+        }
+
+        MakeExclusive(node);
+        NodePtr& child = std::get<NodePtr>(node->Trailing()[index]);
+        Remove(child, shift + kBits, hash, key);
+        // Keep the tree canonical: a lone entry moves up into the parent.
+        // `child` was just copied or found exclusive, so the entry can be moved out.
+        std::span<Slot> child_slots = child->Trailing();
+        if (child_slots.size() == 1 && std::holds_alternative<Entry>(child_slots[0])) {
+            Entry entry = std::move(std::get<Entry>(child_slots[0]));
+            node->Trailing()[index] = std::move(entry);
+        }
+    }
+
+    template <typename Fn>
+    static void Visit(const Node& node, Fn& fn) {
+        for (const Slot& slot : node.Trailing()) {
+            if (const Entry* entry = std::get_if<Entry>(&slot)) {
+                fn(entry->first, entry->second);
+            } else {
+                Visit(*std::get<NodePtr>(slot), fn);
+            }
+        }
+    }
+
+    NodePtr root_;
+    size_t size_ = 0;
+};
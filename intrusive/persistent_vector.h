@@ -0,0 +1,583 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <algorithm>  // std::max, std::min
+#include <cstddef>    // size_t
+#include <span>
+#include <utility>
+#include <vector>
+
+// Persistent vector (RRB tree): copies are O(1) snapshots, `Slice` and `Append` are
+// O(log n) and share everything they don't cut through.
+//
+// Elements sit in leaves of up to 32, stored contiguously right after the leaf header
+// (`TrailingArray`), so `ForEachChunk` hands out plain spans. Inner nodes keep up to 32
+// children with the cumulative size of each, so subtrees may be partly filled ("relaxed")
+// after slicing or concatenation; lookup starts at the radix guess and scans forward.
+// The last elements live in a separate tail leaf, so `PushBack` touches the tree only
+// once per 32 elements.
+//
+// Writes copy the shared part of the path only: a node with `RefCount() == 1` under an
+// unshared parent is changed in place. Nodes use `CompactRefCounted`, single-threaded.
+// `T` must be default-constructible and copy-assignable.
+template <typename T>
+class PersistentVector {
+public:
+    PersistentVector() = default;
+
+    // Snapshots
+    PersistentVector(const PersistentVector&) = default;
+    PersistentVector(PersistentVector&& other) noexcept
+        : root_(std::move(other.root_)),
+          tail_(std::move(other.tail_)),
+          shift_(std::exchange(other.shift_, 0)),
+          tail_size_(std::exchange(other.tail_size_, 0)),
+          size_(std::exchange(other.size_, 0)) {
+    }
+    PersistentVector& operator=(const PersistentVector&) = default;
+    PersistentVector& operator=(PersistentVector&& other) noexcept {
+        PersistentVector(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void PushBack(T value) {
+        if (tail_size_ == kWidth) {
+            PushLeaf(std::move(tail_));
+            tail_size_ = 0;
+        }
+        if (!tail_ || tail_->RefCount() > 1) {
+            tail_ = CopyTail(tail_.Get(), 0, tail_size_);
+        }
+        tail_->Trailing()[tail_size_++] = std::move(value);
+        ++size_;
+    }
+
+    void Set(size_t index, T value) {
+        size_t tail_offset = size_ - tail_size_;
+        if (index >= tail_offset) {
+            if (tail_->RefCount() > 1) {
+                tail_ = CopyTail(tail_.Get(), 0, tail_size_);
+            }
+            tail_->Trailing()[index - tail_offset] = std::move(value);
+        } else {
+            SetIn(root_, shift_, index, std::move(value));
+        }
+    }
+
+    // Appends all elements of `other`, sharing its tree
+    void Append(const PersistentVector& other) {
+        if (other.Empty()) {
+            return;
+        }
+        if (Empty()) {
+            *this = other;
+            return;
+        }
+        if (&other == this) {
+            PersistentVector copy = other;
+            Append(copy);
+            return;
+        }
+        if (!other.root_) {
+            for (size_t i = 0; i < other.tail_size_; ++i) {
+                PushBack(other.tail_->Trailing()[i]);
+            }
+            return;
+        }
+        if (tail_size_ > 0) {
+            PushLeaf(tail_size_ == kWidth ? std::move(tail_) : CopyLeaf(tail_.Get(), 0, tail_size_));
+        }
+        NodePtr joined = Concat(root_, shift_, other.root_, other.shift_);
+        root_ = std::move(joined);
+        shift_ = std::max(shift_, other.shift_) + kBits;
+        CollapseRoot();
+        tail_ = other.tail_;
+        tail_size_ = other.tail_size_;
+        size_ += other.size_;
+    }
+
+    void Clear() {
+        PersistentVector().Swap(*this);
+    }
+
+    void Swap(PersistentVector& other) noexcept {
+        root_.Swap(other.root_);
+        tail_.Swap(other.tail_);
+        std::swap(shift_, other.shift_);
+        std::swap(tail_size_, other.tail_size_);
+        std::swap(size_, other.size_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Access
+
+    const T& operator[](size_t index) const {
+        size_t tail_offset = size_ - tail_size_;
+        if (index >= tail_offset) {
+            return tail_->Trailing()[index - tail_offset];
+        }
+        const Node* node = root_.Get();
+        for (size_t shift = shift_; shift > 0; shift -= kBits) {
+            std::span<const Child> children = static_cast<const Inner*>(node)->Trailing();
+            size_t i = ChildIndex(children, shift, index);
+            index -= StartOf(children, i);
+            node = children[i].node.Get();
+        }
+        return static_cast<const Leaf*>(node)->Trailing()[index];
+    }
+
+    // Elements `[begin, end)` as a new version
+    PersistentVector Slice(size_t begin, size_t end) const {
+        PersistentVector result = *this;
+        result.TakeFront(end);
+        result.DropFront(begin);
+        return result;
+    }
+
+    // `fn(std::span<const T>)` for every leaf in order, then for the tail
+    template <typename Fn>
+    void ForEachChunk(Fn&& fn) const {
+        if (root_) {
+            VisitChunks(root_, shift_, fn);
+        }
+        if (tail_size_ > 0) {
+            fn(std::span<const T>(tail_->Trailing().data(), tail_size_));
+        }
+    }
+
+    template <typename Fn>
+    void ForEach(Fn&& fn) const {
+        ForEachChunk([&fn](std::span<const T> chunk) {
+            for (const T& value : chunk) {
+                fn(value);
+            }
+        });
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    size_t Size() const {
+        return size_;
+    }
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+private:
+    static constexpr size_t kBits = 5;
+    static constexpr size_t kWidth = 32;
+    // `Concat` may leave this many more nodes per level than the minimum
+    static constexpr size_t kExtraNodes = 2;
+
+    struct Node;
+    using NodePtr = IntrusivePtr<Node>;
+
+    // Leaves and inner nodes have different trailing arrays, the flag tells which to free
+    struct NodeDelete {
+        static void Destroy(Node* node) {
+            if (node->is_leaf) {
+                TrailingArrayAccess::Delete(static_cast<Leaf*>(node));
+            } else {
+                TrailingArrayAccess::Delete(static_cast<Inner*>(node));
+            }
+        }
+    };
+
+    struct Node : CompactRefCounted<Node, NodeDelete> {
+        explicit Node(bool is_leaf) : is_leaf(is_leaf) {
+        }
+
+        bool is_leaf;
+    };
+
+    struct Leaf : Node, TrailingArray<Leaf, T> {
+        Leaf() : Node(true) {
+        }
+    };
+
+    // `end` is the number of elements in this child and the ones before it
+    struct Child {
+        NodePtr node;
+        size_t end = 0;
+    };
+
+    struct Inner : Node, TrailingArray<Inner, Child> {
+        Inner() : Node(false) {
+        }
+    };
+
+    using LeafPtr = IntrusivePtr<Leaf>;
+    using InnerPtr = IntrusivePtr<Inner>;
+
+    static Leaf* AsLeaf(const NodePtr& node) {
+        return static_cast<Leaf*>(node.Get());
+    }
+    static Inner* AsInner(const NodePtr& node) {
+        return static_cast<Inner*>(node.Get());
+    }
+
+    static size_t SizeOf(const NodePtr& node) {
+        return node->is_leaf ? AsLeaf(node)->Trailing().size() : AsInner(node)->Trailing().back().end;
+    }
+    static size_t SlotCount(const NodePtr& node) {
+        return node->is_leaf ? AsLeaf(node)->Trailing().size() : AsInner(node)->Trailing().size();
+    }
+
+    // A child of a node at `shift` holds at most `1 << shift` elements, so the radix
+    // guess never overshoots
+    static size_t ChildIndex(std::span<const Child> children, size_t shift, size_t index) {
+        size_t i = index >> shift;
+        while (children[i].end <= index) {
+            ++i;
+        }
+        return i;
+    }
+    static size_t StartOf(std::span<const Child> children, size_t i) {
+        return i == 0 ? 0 : children[i - 1].end;
+    }
+
+    // Exact-size leaf with elements `[begin, end)` of `leaf`
+    static LeafPtr CopyLeaf(const Leaf* leaf, size_t begin, size_t end) {
+        LeafPtr result = MakeIntrusiveWithTrailing<Leaf, T>(end - begin);
+        std::span<const T> from = leaf->Trailing();
+        std::copy(from.begin() + begin, from.begin() + end, result->Trailing().begin());
+        return result;
+    }
+
+    // Full-capacity tail starting with elements `[begin, end)` of `leaf`
+    static LeafPtr CopyTail(const Leaf* leaf, size_t begin, size_t end) {
+        LeafPtr result = MakeIntrusiveWithTrailing<Leaf, T>(kWidth);
+        if (leaf) {
+            std::span<const T> from = leaf->Trailing();
+            std::copy(from.begin() + begin, from.begin() + end, result->Trailing().begin());
+        }
+        return result;
+    }
+
+    static InnerPtr MakeInner(std::span<const NodePtr> children) {
+        InnerPtr result = MakeIntrusiveWithTrailing<Inner, Child>(children.size());
+        size_t end = 0;
+        for (size_t i = 0; i < children.size(); ++i) {
+            end += SizeOf(children[i]);
+            result->Trailing()[i] = Child{children[i], end};
+        }
+        return result;
+    }
+
+    // Copy of `node` with room for `extra` more children; they are moved out if
+    // nobody else holds `node`
+    static NodePtr CopyNode(const NodePtr& node, size_t extra = 0) {
+        if (node->is_leaf) {
+            return CopyLeaf(AsLeaf(node), 0, SlotCount(node));
+        }
+        std::span<Child> from = AsInner(node)->Trailing();
+        InnerPtr result = MakeIntrusiveWithTrailing<Inner, Child>(from.size() + extra);
+        if (node->RefCount() == 1) {
+            std::move(from.begin(), from.end(), result->Trailing().begin());
+        } else {
+            std::copy(from.begin(), from.end(), result->Trailing().begin());
+        }
+        return result;
+    }
+
+    static void MakeExclusive(NodePtr& node) {
+        if (node->RefCount() > 1) {
+            node = CopyNode(node);
+        }
+    }
+
+    static void SetIn(NodePtr& node, size_t shift, size_t index, T&& value) {
+        MakeExclusive(node);
+        if (shift == 0) {
+            AsLeaf(node)->Trailing()[index] = std::move(value);
+            return;
+        }
+        std::span<Child> children = AsInner(node)->Trailing();
+        size_t i = ChildIndex(children, shift, index);
+        SetIn(children[i].node, shift - kBits, index - StartOf(children, i), std::move(value));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Growing the tree
+
+    // Chain of single-child nodes from `shift` down to `leaf`
+    static NodePtr NewPath(size_t shift, NodePtr leaf) {
+        if (shift == 0) {
+            return leaf;
+        }
+        NodePtr child = NewPath(shift - kBits, std::move(leaf));
+        return MakeInner(std::span<const NodePtr>(&child, 1));
+    }
+
+    static bool HasRoom(const NodePtr& node, size_t shift) {
+        if (shift == 0) {
+            return false;
+        }
+        std::span<Child> children = AsInner(node)->Trailing();
+        return children.size() < kWidth || HasRoom(children.back().node, shift - kBits);
+    }
+
+    static void AppendLeaf(NodePtr& node, size_t shift, LeafPtr&& leaf) {
+        size_t count = leaf->Trailing().size();
+        if (shift > kBits && HasRoom(AsInner(node)->Trailing().back().node, shift - kBits)) {
+            MakeExclusive(node);
+            Child& last = AsInner(node)->Trailing().back();
+            AppendLeaf(last.node, shift - kBits, std::move(leaf));
+            last.end += count;
+            return;
+        }
+        size_t end = SizeOf(node) + count;
+        NodePtr grown = CopyNode(node, 1);
+        AsInner(grown)->Trailing().back() = Child{NewPath(shift - kBits, std::move(leaf)), end};
+        node = std::move(grown);
+    }
+
+    // `leaf` must be exactly as long as its contents
+    void PushLeaf(LeafPtr&& leaf) {
+        if (!root_) {
+            root_ = std::move(leaf);
+            shift_ = 0;
+        } else if (HasRoom(root_, shift_)) {
+            AppendLeaf(root_, shift_, std::move(leaf));
+        } else {
+            NodePtr nodes[] = {std::move(root_), NewPath(shift_, std::move(leaf))};
+            root_ = MakeInner(nodes);
+            shift_ += kBits;
+        }
+    }
+
+    void CollapseRoot() {
+        while (shift_ > 0 && AsInner(root_)->Trailing().size() == 1) {
+            NodePtr child = AsInner(root_)->Trailing()[0].node;
+            root_ = std::move(child);
+            shift_ -= kBits;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Slicing
+
+    // First `count` elements of a subtree, `0 < count`
+    static NodePtr TakeTree(const NodePtr& node, size_t shift, size_t count) {
+        if (count == SizeOf(node)) {
+            return node;
+        }
+        if (shift == 0) {
+            return CopyLeaf(AsLeaf(node), 0, count);
+        }
+        std::span<Child> children = AsInner(node)->Trailing();
+        size_t last = ChildIndex(children, shift, count - 1);
+        InnerPtr result = MakeIntrusiveWithTrailing<Inner, Child>(last + 1);
+        std::copy(children.begin(), children.begin() + last, result->Trailing().begin());
+        result->Trailing()[last] = Child{
+            TakeTree(children[last].node, shift - kBits, count - StartOf(children, last)), count};
+        return result;
+    }
+
+    // A subtree without its first `count` elements, `count < SizeOf(node)`
+    static NodePtr DropTree(const NodePtr& node, size_t shift, size_t count) {
+        if (count == 0) {
+            return node;
+        }
+        if (shift == 0) {
+            return CopyLeaf(AsLeaf(node), count, SlotCount(node));
+        }
+        std::span<Child> children = AsInner(node)->Trailing();
+        size_t first = ChildIndex(children, shift, count);
+        InnerPtr result = MakeIntrusiveWithTrailing<Inner, Child>(children.size() - first);
+        std::span<Child> to = result->Trailing();
+        to[0] = Child{DropTree(children[first].node, shift - kBits, count - StartOf(children, first)),
+                      children[first].end - count};
+        for (size_t i = first + 1; i < children.size(); ++i) {
+            to[i - first] = Child{children[i].node, children[i].end - count};
+        }
+        return result;
+    }
+
+    void TakeFront(size_t count) {
+        size_t tail_offset = size_ - tail_size_;
+        if (count == 0) {
+            Clear();
+            return;
+        }
+        if (count >= tail_offset) {
+            tail_size_ = count - tail_offset;
+        } else {
+            // The tree now ends with a partial leaf, the next `PushBack` starts a fresh tail
+            tail_.Reset();
+            tail_size_ = 0;
+            root_ = TakeTree(root_, shift_, count);
+        }
+        size_ = count;
+        if (root_) {
+            CollapseRoot();
+        }
+    }
+
+    void DropFront(size_t count) {
+        size_t tail_offset = size_ - tail_size_;
+        if (count >= tail_offset) {
+            tail_ = CopyTail(tail_.Get(), count - tail_offset, tail_size_);
+            tail_size_ = size_ - count;
+            root_.Reset();
+            shift_ = 0;
+        } else if (count > 0) {
+            root_ = DropTree(root_, shift_, count);
+            CollapseRoot();
+        }
+        size_ -= count;
+        if (size_ == 0) {
+            Clear();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Concatenation (Bagwell & Rompf, "RRB-Trees: Efficient Immutable Vectors")
+
+    // Node one level above both trees with one or two children holding all their elements
+    static NodePtr Concat(const NodePtr& left, size_t left_shift, const NodePtr& right,
+                          size_t right_shift) {
+        if (left_shift > right_shift) {
+            NodePtr centre = Concat(AsInner(left)->Trailing().back().node, left_shift - kBits, right,
+                                    right_shift);
+            return Rebalance(left, centre, nullptr, left_shift);
+        }
+        if (left_shift < right_shift) {
+            NodePtr centre = Concat(left, left_shift, AsInner(right)->Trailing().front().node,
+                                    right_shift - kBits);
+            return Rebalance(nullptr, centre, right, right_shift);
+        }
+        if (left_shift == 0) {
+            if (SizeOf(left) + SizeOf(right) <= kWidth) {
+                std::vector<NodePtr> leaves = {left, right};
+                std::vector<size_t> counts = {SizeOf(left) + SizeOf(right)};
+                return MakeInner(Redistribute(leaves, counts, true));
+            }
+            NodePtr leaves[] = {left, right};
+            return MakeInner(leaves);
+        }
+        NodePtr centre = Concat(AsInner(left)->Trailing().back().node, left_shift - kBits,
+                                AsInner(right)->Trailing().front().node, right_shift - kBits);
+        return Rebalance(left, centre, right, left_shift);
+    }
+
+    // Children of `left` (but its last), `centre` and `right` (but its first) are repacked
+    // so that there are at most `kExtraNodes` more of them than strictly needed
+    static NodePtr Rebalance(const NodePtr& left, const NodePtr& centre, const NodePtr& right,
+                             size_t shift) {
+        std::vector<NodePtr> all;
+        if (left) {
+            std::span<Child> children = AsInner(left)->Trailing();
+            for (size_t i = 0; i + 1 < children.size(); ++i) {
+                all.push_back(children[i].node);
+            }
+        }
+        for (const Child& child : AsInner(centre)->Trailing()) {
+            all.push_back(child.node);
+        }
+        if (right) {
+            std::span<Child> children = AsInner(right)->Trailing();
+            for (size_t i = 1; i < children.size(); ++i) {
+                all.push_back(children[i].node);
+            }
+        }
+
+        std::vector<NodePtr> packed = Redistribute(all, Plan(all), shift == kBits);
+        std::span<const NodePtr> nodes(packed);
+        NodePtr halves[] = {MakeInner(nodes.first(std::min(nodes.size(), kWidth))), nullptr};
+        if (nodes.size() <= kWidth) {
+            return MakeInner(std::span<const NodePtr>(halves, 1));
+        }
+        halves[1] = MakeInner(nodes.subspan(kWidth));
+        return MakeInner(halves);
+    }
+
+    // New slot counts: short nodes are merged into their right neighbours
+    static std::vector<size_t> Plan(const std::vector<NodePtr>& nodes) {
+        std::vector<size_t> counts;
+        size_t total = 0;
+        for (const NodePtr& node : nodes) {
+            counts.push_back(SlotCount(node));
+            total += counts.back();
+        }
+        size_t optimal = (total + kWidth - 1) / kWidth;
+        size_t size = counts.size();
+        size_t i = 0;
+        while (size > optimal + kExtraNodes) {
+            while (counts[i] >= kWidth - 1) {
+                ++i;
+            }
+            size_t remaining = counts[i];
+            do {
+                size_t filled = std::min(remaining + counts[i + 1], kWidth);
+                remaining = remaining + counts[i + 1] - filled;
+                counts[i] = filled;
+                ++i;
+            } while (remaining > 0);
+            std::copy(counts.begin() + i + 1, counts.begin() + size, counts.begin() + i);
+            --size;
+            --i;
+        }
+        counts.resize(size);
+        return counts;
+    }
+
+    // Follows `counts`, nodes that come out unchanged are shared instead of copied
+    static std::vector<NodePtr> Redistribute(const std::vector<NodePtr>& nodes,
+                                             const std::vector<size_t>& counts, bool leaves) {
+        std::vector<NodePtr> result;
+        size_t source = 0;
+        size_t offset = 0;
+        for (size_t count : counts) {
+            if (offset == 0 && SlotCount(nodes[source]) == count) {
+                result.push_back(nodes[source++]);
+                continue;
+            }
+            if (leaves) {
+                LeafPtr leaf = MakeIntrusiveWithTrailing<Leaf, T>(count);
+                for (T& value : leaf->Trailing()) {
+                    value = AsLeaf(nodes[source])->Trailing()[offset];
+                    if (++offset == SlotCount(nodes[source])) {
+                        ++source;
+                        offset = 0;
+                    }
+                }
+                result.push_back(std::move(leaf));
+            } else {
+                std::vector<NodePtr> children;
+                for (size_t i = 0; i < count; ++i) {
+                    children.push_back(AsInner(nodes[source])->Trailing()[offset].node);
+                    if (++offset == SlotCount(nodes[source])) {
+                        ++source;
+                        offset = 0;
+                    }
+                }
+                result.push_back(MakeInner(children));
+            }
+        }
+        return result;
+    }
+
+    template <typename Fn>
+    static void VisitChunks(const NodePtr& node, size_t shift, Fn& fn) {
+        if (shift == 0) {
+            fn(std::span<const T>(AsLeaf(node)->Trailing()));
+            return;
+        }
+        for (const Child& child : AsInner(node)->Trailing()) {
+            VisitChunks(child.node, shift - kBits, fn);
+        }
+    }
+
+    NodePtr root_;
+    // Capacity `kWidth`, only the first `tail_size_` elements belong to this version
+    LeafPtr tail_;
+    size_t shift_ = 0;
+    size_t tail_size_ = 0;
+    size_t size_ = 0;
+};
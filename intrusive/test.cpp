@@ -1,10 +1,17 @@
 #include "intrusive.h"
+#include "persistent_hash_map.h"
+#include "persistent_vector.h"
+
+#include <common/function_deleter.h>
+#include <common/op_counter.h>
 
 #include <catch.hpp>
 
 #include "allocations_checker.h"
 
 #include <string>
+#include <type_traits>
+#include <vector>
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -386,3 +393,322 @@ TEST_CASE("Object pool") {
         REQUIRE(strs.NumInUse() == 1);
     }
 }
+
+struct Slot : ObjectCounters<Slot> {
+    int value = 5;
+};
+
+struct TaggedSlots : SimpleRefCounted<TaggedSlots>, TrailingArray<TaggedSlots, Slot> {
+    explicit TaggedSlots(int tag) : tag(tag) {
+    }
+
+    int tag;
+};
+
+TEST_CASE("MakeIntrusiveWithTrailing") {
+    Slot::ResetCounters();
+    {
+        IntrusivePtr<TaggedSlots> a;
+        EXPECT_ONE_ALLOCATION(a = MakeIntrusiveWithTrailing<TaggedSlots, Slot>(4, 17));
+        IntrusivePtr<TaggedSlots> b = a;
+        REQUIRE(b->tag == 17);
+        REQUIRE(b->Trailing().size() == 4);
+        REQUIRE(b->Trailing()[3].value == 5);
+        REQUIRE(Slot::NumAlive() == 4);
+    }
+    REQUIRE(Slot::NumCreated() == 4);
+    REQUIRE(Slot::NumAlive() == 0);
+
+    IntrusivePtr<TaggedSlots> plain(new TaggedSlots(1));
+    REQUIRE(plain->Trailing().empty());
+}
+
+struct CompactInt : CompactRefCounted<CompactInt> {
+    constexpr CompactInt(int value) : value{value} {
+    }
+
+    constexpr CompactInt(ImmortalTag tag, int value) : CompactRefCounted<CompactInt>(tag), value{value} {
+    }
+
+    int value = 0;
+};
+
+constinit CompactInt immortal_int(kImmortal, 42);
+
+TEST_CASE("Compact counter") {
+    SECTION("Sizeof") {
+        REQUIRE(sizeof(CompactInt) == 8);
+        REQUIRE(sizeof(CompactInt) < sizeof(MyInt));
+    }
+
+    SECTION("Regular lifetime") {
+        IntrusivePtr<CompactInt> a = MakeIntrusive<CompactInt>(1);
+        IntrusivePtr<CompactInt> b = a;
+        REQUIRE(a.UseCount() == 2);
+        b.Reset();
+        REQUIRE(a.UseCount() == 1);
+    }
+
+    SECTION("Immortal") {
+        REQUIRE(immortal_int.RefCount() == CompactCounter::kSaturated);
+        {
+            IntrusivePtr<CompactInt> a(&immortal_int);
+            IntrusivePtr<CompactInt> b = a;
+            REQUIRE(b->value == 42);
+        }
+        REQUIRE(immortal_int.RefCount() == CompactCounter::kSaturated);
+    }
+
+    SECTION("Immortal counter") {
+        CompactCounter counter;
+        REQUIRE(counter.IncRef() == 1);
+        REQUIRE(!counter.IsImmortal());
+
+        CompactCounter immortal(kImmortal);
+        REQUIRE(immortal.IsImmortal());
+        REQUIRE(immortal.IncRef() == CompactCounter::kSaturated);
+        REQUIRE(immortal.DecRef() == CompactCounter::kSaturated);
+    }
+}
+
+TEST_CASE("Noexcept moves") {
+    static_assert(std::is_nothrow_move_constructible_v<IntrusivePtr<MyInt>>);
+    static_assert(std::is_nothrow_move_assignable_v<IntrusivePtr<MyInt>>);
+    static_assert(kIsTriviallyRelocatable<IntrusivePtr<MyInt>>);
+
+    std::vector<IntrusivePtr<MyInt>> vector;
+    IntrusivePtr<MyInt> a(new MyInt(3));
+    for (int i = 0; i < 100; ++i) {
+        vector.push_back(a);
+    }
+    REQUIRE(a->RefCount() == 101);
+}
+
+struct Handle;
+
+int released_handles = 0;
+
+void ReleaseHandle(Handle* handle);
+
+struct Handle : SimpleRefCounted<Handle, FunctionDeleter<&ReleaseHandle>> {};
+
+void ReleaseHandle(Handle* handle) {
+    delete handle;
+    ++released_handles;
+}
+
+TEST_CASE("FunctionDeleter") {
+    {
+        auto a = MakeIntrusive<Handle>();
+        auto b = a;
+    }
+    REQUIRE(released_handles == 1);
+}
+
+struct Shape : RefCounted<Shape, OpCountingRefCounter, DefaultDelete> {
+    virtual ~Shape() = default;
+};
+
+struct Circle : Shape {
+    int radius = 2;
+};
+
+struct Square : Shape {};
+
+TEST_CASE("Casts") {
+    IntrusivePtr<Shape> shape(new Circle());
+    RefcountOps::Reset();
+
+    SECTION("Rvalue casts move the reference") {
+        auto circle = StaticPointerCast<Circle>(std::move(shape));
+        REQUIRE(!shape);
+        REQUIRE(circle->radius == 2);
+        IntrusivePtr<Shape> back = std::move(circle);
+        auto square = DynamicPointerCast<Square>(std::move(back));
+        REQUIRE(!square);
+        REQUIRE(back);
+        REQUIRE(back.UseCount() == 1);
+        REQUIRE(RefcountOps::Total() == 0);
+    }
+
+    SECTION("Lvalue casts share") {
+        auto circle = DynamicPointerCast<Circle>(shape);
+        REQUIRE(circle.UseCount() == 2);
+        REQUIRE(RefcountOps::increments == 1);
+        REQUIRE(RefcountOps::decrements == 0);
+    }
+}
+
+TEST_CASE("Bulk retain/release") {
+    std::vector<IntrusivePtr<Shape>> ptrs;
+    for (int i = 0; i < 10; ++i) {
+        ptrs.push_back(MakeIntrusive<Circle>());
+    }
+    for (int i = 10; i < 1000; ++i) {
+        ptrs.push_back(ptrs[i % 10]);
+    }
+    ptrs.emplace_back();
+    RefcountOps::Reset();
+
+    auto copies = RetainAll(ptrs);
+    REQUIRE(copies.size() == 1001);
+    REQUIRE(copies[7] == ptrs[7]);
+    REQUIRE(ptrs[7].UseCount() == 200);
+    REQUIRE(RefcountOps::increments == 10);
+
+    ReleaseAll(copies);
+    ReleaseAll(ptrs);
+    REQUIRE(!ptrs[0]);
+    REQUIRE(RefcountOps::decrements == 20);
+
+    SECTION("Counters") {
+        CompactCounter counter;
+        REQUIRE(counter.IncRef(5) == 5);
+        REQUIRE(counter.DecRef(2) == 3);
+        REQUIRE(counter.IncRef(CompactCounter::kSaturated) == CompactCounter::kSaturated);
+        REQUIRE(counter.DecRef(3) == CompactCounter::kSaturated);
+    }
+
+    SECTION("Types without counted IncRef") {
+        ObjectPool<PoolableString> strs;
+        std::vector<IntrusivePtr<PoolableString>> objects(3, strs.Allocate("first"));
+        auto more = RetainAll(objects);
+        REQUIRE(objects[0].UseCount() == 6);
+        ReleaseAll(more);
+        ReleaseAll(objects);
+        REQUIRE(strs.NumAvailable() == 1);
+    }
+}
+
+// Only 3 distinct hashes: exercises deep branches and collision nodes
+struct CrowdedHash {
+    size_t operator()(int key) const {
+        return static_cast<size_t>(key % 3);
+    }
+};
+
+TEST_CASE("PersistentHashMap") {
+    PersistentHashMap<int, std::string> map;
+    for (int i = 0; i < 1000; ++i) {
+        REQUIRE(map.Set(i, std::to_string(i)));
+    }
+    REQUIRE(!map.Set(7, "seven"));
+    REQUIRE(map.Size() == 1000);
+
+    auto snapshot = map;
+    for (int i = 0; i < 1000; i += 2) {
+        REQUIRE(map.Erase(i));
+    }
+    REQUIRE(map.Set(2000, "new"));
+    REQUIRE(!map.Erase(0));
+
+    REQUIRE(snapshot.Size() == 1000);
+    REQUIRE(*snapshot.Find(0) == "0");
+    REQUIRE(*snapshot.Find(7) == "seven");
+    REQUIRE(!snapshot.Contains(2000));
+    REQUIRE(map.Size() == 501);
+    REQUIRE(!map.Contains(0));
+    REQUIRE(*map.Find(999) == "999");
+
+    size_t visited = 0;
+    map.ForEach([&](int key, const std::string& value) {
+        visited += map.Find(key) == &value;
+    });
+    REQUIRE(visited == 501);
+
+    // The map is the only owner of its nodes now: overwriting happens in place
+    snapshot.Clear();
+    EXPECT_ZERO_ALLOCATIONS(map.Set(999, "x"));
+    REQUIRE(*map.Find(999) == "x");
+}
+
+TEST_CASE("PersistentHashMap collisions") {
+    PersistentHashMap<int, int, CrowdedHash> map;
+    for (int i = 0; i < 30; ++i) {
+        map.Set(i, i * i);
+    }
+    auto snapshot = map;
+    for (int i = 0; i < 30; ++i) {
+        REQUIRE(*map.Find(i) == i * i);
+        if (i % 2) {
+            REQUIRE(map.Erase(i));
+        }
+    }
+    REQUIRE(map.Size() == 15);
+    REQUIRE(!map.Contains(1));
+    REQUIRE(*map.Find(28) == 28 * 28);
+    REQUIRE(*snapshot.Find(29) == 29 * 29);
+    for (int i = 0; i < 30; i += 2) {
+        REQUIRE(map.Erase(i));
+    }
+    REQUIRE(map.Empty());
+    REQUIRE(snapshot.Size() == 30);
+}
+
+template <typename T>
+std::vector<T> ToStdVector(const PersistentVector<T>& vector) {
+    std::vector<T> result;
+    vector.ForEach([&](const T& value) { result.push_back(value); });
+    return result;
+}
+
+TEST_CASE("PersistentVector") {
+    PersistentVector<int> vector;
+    std::vector<int> expected;
+    for (int i = 0; i < 5000; ++i) {
+        vector.PushBack(i);
+        expected.push_back(i);
+    }
+    auto snapshot = vector;
+    for (size_t i = 0; i < expected.size(); i += 7) {
+        vector.Set(i, -1);
+        expected[i] = -1;
+    }
+    REQUIRE(ToStdVector(vector) == expected);
+    REQUIRE(snapshot[7] == 7);
+    REQUIRE(snapshot[4999] == 4999);
+    REQUIRE(vector[4998] == expected[4998]);
+
+    // Unshared nodes are written in place
+    snapshot.Clear();
+    EXPECT_ZERO_ALLOCATIONS(vector.Set(1234, 42));
+    EXPECT_ZERO_ALLOCATIONS(vector.PushBack(5000));
+    expected[1234] = 42;
+    expected.push_back(5000);
+
+    auto slice = vector.Slice(1000, 3333);
+    REQUIRE(slice.Size() == 2333);
+    REQUIRE(ToStdVector(slice) == std::vector<int>(expected.begin() + 1000, expected.begin() + 3333));
+    REQUIRE(vector.Size() == 5001);
+}
+
+TEST_CASE("PersistentVector concatenation") {
+    std::vector<int> expected;
+    PersistentVector<int> vector;
+    // Odd sizes leave partial leaves in the middle of the tree
+    for (int part = 0; part < 40; ++part) {
+        PersistentVector<int> piece;
+        for (int i = 0; i < part * 37 + 5; ++i) {
+            piece.PushBack(part * 10000 + i);
+            expected.push_back(part * 10000 + i);
+        }
+        vector.Append(piece.Slice(0, piece.Size()));
+        REQUIRE(vector.Size() == expected.size());
+    }
+    REQUIRE(ToStdVector(vector) == expected);
+    for (size_t i = 0; i < expected.size(); i += 13) {
+        REQUIRE(vector[i] == expected[i]);
+    }
+
+    auto doubled = vector;
+    doubled.Append(vector.Slice(17, vector.Size() - 3));
+    doubled.PushBack(7);
+    std::vector<int> doubled_expected = expected;
+    doubled_expected.insert(doubled_expected.end(), expected.begin() + 17, expected.end() - 3);
+    doubled_expected.push_back(7);
+    REQUIRE(ToStdVector(doubled) == doubled_expected);
+    for (size_t i = 0; i < doubled_expected.size(); i += 11) {
+        REQUIRE(doubled[i] == doubled_expected[i]);
+    }
+    REQUIRE(ToStdVector(vector) == expected);
+}
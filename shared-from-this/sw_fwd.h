@@ -1,12 +1,15 @@
 #pragma once
 
-#include <exception>
+#include <common/shared_fwd.h>
 
-// Instead of std::bad_weak_ptr
-class BadWeakPtr : public std::exception {};
+// Full feature set
+using DefaultSharedPolicy = SharedPolicy<SingleThreaded, WeakSupport::kOn, SharedFromThisSupport::kOn>;
 
-template <typename T>
+template <typename T, typename Policy = DefaultSharedPolicy>
 class SharedPtr;
 
-template <typename T>
+template <typename T, typename Policy = DefaultSharedPolicy>
 class WeakPtr;
+
+template <typename T, typename Policy = DefaultSharedPolicy>
+class EnableSharedFromThis;
@@ -89,3 +89,27 @@ TEST_CASE("WeakFromThis") {
     REQUIRE(!weak.Expired());
     REQUIRE(weak.Lock().Get() == ptr);
 }
+
+TEST_CASE("WeakThis bound once") {
+    SECTION("Reset") {
+        SharedPtr<T> s;
+        s.Reset(new T);
+        REQUIRE(s->SharedFromThis() == s);
+    }
+
+    SECTION("Copies keep the binding") {
+        auto s = MakeShared<T>();
+        SharedPtr<T> copy = s;
+        SharedPtr<T> moved = std::move(copy);
+        SharedPtr<Y> other(new Y);
+        SharedPtr<T> converted = other;
+        REQUIRE(moved->SharedFromThis() == s);
+        REQUIRE(converted->SharedFromThis() == other);
+        REQUIRE(s.UseCount() == 2);
+    }
+
+    SECTION("Never owned") {
+        T t;
+        REQUIRE(t.WeakFromThis().Expired());
+    }
+}
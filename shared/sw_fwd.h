@@ -1,11 +1,13 @@
 #pragma once
 
-#include <exception>
+#include <common/shared_fwd.h>
 
-class BadWeakPtr : public std::exception {};
+// No weak counters in the control blocks: this directory has no `WeakPtr`
+using DefaultSharedPolicy = SharedPolicy<SingleThreaded, WeakSupport::kOff, SharedFromThisSupport::kOff>;
 
-template <typename T>
+template <typename T, typename Policy = DefaultSharedPolicy>
 class SharedPtr;
 
-template <typename T>
+template <typename T, typename Policy = DefaultSharedPolicy>
 class WeakPtr;
+
@@ -4,7 +4,29 @@
 
 #include "allocations_checker.h"
 
+#include <common/cow_ptr.h>
+#include <common/function_deleter.h>
+#include <common/mapped_file.h>
+#include <common/my_int.h>
+#include <common/op_counter.h>
+#include <common/pointer_hash_map.h>
+#include <common/shared_buffer.h>
+#include <common/shared_ptr_vector.h>
+#include <common/small_vector.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
 #include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -467,3 +489,525 @@ TEST_CASE("Destructor for correct type") {
         REQUIRE(B::destructor_called);
     }
 }
+
+struct Packet : TrailingArray<Packet, MyInt> {
+    explicit Packet(int tag) : tag(tag) {
+    }
+
+    int tag;
+};
+
+TEST_CASE("MakeSharedWithTrailing") {
+    SECTION("One allocation") {
+        EXPECT_ONE_ALLOCATION(auto p = MakeSharedWithTrailing<Packet, MyInt>(16, 7));
+    }
+
+    SECTION("Elements") {
+        auto p = MakeSharedWithTrailing<Packet, MyInt>(5, 42);
+        REQUIRE(p->tag == 42);
+        REQUIRE(p->Trailing().size() == 5);
+        REQUIRE(MyInt::AliveCount() == 5);
+        REQUIRE(reinterpret_cast<char*>(p->Trailing().data()) >= reinterpret_cast<char*>(p.Get() + 1));
+        p.Reset();
+        REQUIRE(MyInt::AliveCount() == 0);
+    }
+
+    SECTION("Empty trailing array") {
+        auto p = MakeSharedWithTrailing<Packet, MyInt>(0, 1);
+        REQUIRE(p->Trailing().empty());
+        SharedPtr<Packet> plain(new Packet(2));
+        REQUIRE(plain->Trailing().empty());
+    }
+}
+
+TEST_CASE("ImmortalShared") {
+    static const std::string kGreeting = "hello";
+    SharedPtr<const std::string> a;
+    EXPECT_ZERO_ALLOCATIONS(a = ImmortalShared(kGreeting));
+    {
+        SharedPtr<const std::string> b = a;
+        REQUIRE(*b == "hello");
+        REQUIRE(b.UseCount() == 1);
+    }
+    a.Reset();
+    REQUIRE(kGreeting == "hello");
+}
+
+TEST_CASE("Policies") {
+    using WeakPolicy = SharedPolicy<SingleThreaded, WeakSupport::kOn, SharedFromThisSupport::kOff>;
+    static_assert(sizeof(ObjectControlBlock<int, DefaultSharedPolicy>) <
+                  sizeof(ObjectControlBlock<int, WeakPolicy>));
+
+    auto a = MakeShared<MyInt, WeakPolicy>(3);
+    SharedPtr<MyInt, WeakPolicy> b = a;
+    REQUIRE(b.UseCount() == 2);
+    a.Reset();
+    b.Reset();
+    REQUIRE(MyInt::AliveCount() == 0);
+}
+
+TEST_CASE("Relocation") {
+    static_assert(std::is_nothrow_move_constructible_v<SharedPtr<int>>);
+    static_assert(std::is_nothrow_move_assignable_v<SharedPtr<int>>);
+    static_assert(kIsTriviallyRelocatable<SharedPtr<int>>);
+    static_assert(!kIsTriviallyRelocatable<std::string>);
+
+    SECTION("Growth keeps counters untouched") {
+        auto shared = MakeShared<MyInt>(5);
+        SmallVector<SharedPtr<MyInt>, 2> vector;
+        for (int i = 0; i < 100; ++i) {
+            vector.PushBack(shared);
+        }
+        REQUIRE(!vector.IsInline());
+        REQUIRE(shared.UseCount() == 101);
+        for (const auto& element : vector) {
+            REQUIRE(element.Get() == shared.Get());
+        }
+
+        SmallVector<SharedPtr<MyInt>, 2> moved = std::move(vector);
+        REQUIRE(vector.Empty());
+        REQUIRE(moved.Size() == 100);
+        REQUIRE(shared.UseCount() == 101);
+        moved.Clear();
+        REQUIRE(shared.UseCount() == 1);
+    }
+
+    SECTION("Elements that are not trivially relocatable") {
+        SmallVector<std::string, 2> vector;
+        for (int i = 0; i < 10; ++i) {
+            vector.PushBack(std::string(30, 'a' + i));
+        }
+        vector.PushBack(vector[0]);
+        REQUIRE(vector.Size() == 11);
+        REQUIRE(vector.Back() == std::string(30, 'a'));
+        REQUIRE(vector[9] == std::string(30, 'j'));
+
+        SmallVector<std::string, 2> copy = vector;
+        vector.PopBack();
+        REQUIRE(copy.Size() == 11);
+        REQUIRE(vector.Size() == 10);
+    }
+
+    SECTION("Inline storage") {
+        SmallVector<SharedPtr<int>, 4> vector;
+        vector.EmplaceBack(new int(1));
+        vector.EmplaceBack(new int(2));
+        SmallVector<SharedPtr<int>, 4> moved = std::move(vector);
+        REQUIRE(moved.IsInline());
+        REQUIRE(*moved[1] == 2);
+        REQUIRE(moved[0].UseCount() == 1);
+    }
+}
+
+int released_handles = 0;
+
+void ReleaseHandle(int* handle) {
+    delete handle;
+    ++released_handles;
+}
+
+TEST_CASE("Custom deleter") {
+    static_assert(sizeof(DeleterControlBlock<int, FunctionDeleter<&ReleaseHandle>,
+                                             DefaultSharedPolicy>) ==
+                  sizeof(PtrControlBlock<int, DefaultSharedPolicy>));
+
+    released_handles = 0;
+    SECTION("FunctionDeleter") {
+        SharedPtr<int> a(new int(3), FunctionDeleter<&ReleaseHandle>());
+        SharedPtr<int> b = a;
+        a.Reset();
+        REQUIRE(released_handles == 0);
+        b.Reset(new int(4), FunctionDeleter<&ReleaseHandle>());
+        REQUIRE(released_handles == 1);
+        REQUIRE(*b == 4);
+        b.Reset();
+        REQUIRE(released_handles == 2);
+    }
+
+    SECTION("Stateful deleter") {
+        int calls = 0;
+        {
+            SharedPtr<MyInt> a(new MyInt(1), [&calls](MyInt* ptr) {
+                ++calls;
+                delete ptr;
+            });
+            REQUIRE(*a == 1);
+        }
+        REQUIRE(calls == 1);
+        REQUIRE(MyInt::AliveCount() == 0);
+    }
+}
+
+TEST_CASE("Pointer casts") {
+    SharedPtr<Base> base = MakeShared<Derived>();
+
+    auto derived = DynamicPointerCast<Derived>(base);
+    REQUIRE(derived.Get() == base.Get());
+    REQUIRE(base.UseCount() == 2);
+    REQUIRE(!DynamicPointerCast<Derived>(SharedPtr<Base>(new Base())));
+
+    SharedPtr<const Derived> constant = std::move(derived);
+    auto mutable_derived = ConstPointerCast<Derived>(std::move(constant));
+    REQUIRE(!constant);
+    auto moved = StaticPointerCast<Derived>(std::move(base));
+    REQUIRE(!base);
+    REQUIRE(moved.Get() == mutable_derived.Get());
+    REQUIRE(moved.UseCount() == 2);
+}
+
+TEST_CASE("Owner-based comparison") {
+    struct Pair {
+        int first = 1;
+        int second = 2;
+    };
+    auto pair = MakeShared<Pair>();
+    SharedPtr<int> first(pair, &pair->first);
+    SharedPtr<int> second(pair, &pair->second);
+    SharedPtr<int> other(new int(1));
+
+    REQUIRE(!(first == second));
+    REQUIRE(first.OwnerEqual(second));
+    REQUIRE(first.OwnerEqual(pair));
+    REQUIRE(first.OwnerHash() == second.OwnerHash());
+    REQUIRE(!first.OwnerEqual(other));
+    REQUIRE(first.OwnerBefore(other) != other.OwnerBefore(first));
+
+    std::map<SharedPtr<int>, int, OwnerLess> owners;
+    owners[first] = 1;
+    owners[second] = 2;
+    owners[other] = 3;
+    REQUIRE(owners.size() == 2);
+    REQUIRE(owners[first] == 2);
+}
+
+TEST_CASE("PointerHashMap") {
+    SECTION("Raw pointer keys") {
+        std::vector<std::unique_ptr<int>> objects;
+        PointerHashMap<int*, int> map;
+        for (int i = 0; i < 1000; ++i) {
+            objects.push_back(std::make_unique<int>(i));
+            REQUIRE(map.TryEmplace(objects.back().get(), i).second);
+        }
+        REQUIRE(map.Size() == 1000);
+        REQUIRE(!map.TryEmplace(objects[5].get(), 0).second);
+
+        for (int i = 0; i < 1000; i += 2) {
+            REQUIRE(map.Erase(objects[i].get()));
+        }
+        REQUIRE(!map.Erase(objects[0].get()));
+        REQUIRE(map.Size() == 500);
+        for (int i = 0; i < 1000; ++i) {
+            int* value = map.Find(objects[i].get());
+            if (i % 2 == 0) {
+                REQUIRE(value == nullptr);
+            } else {
+                REQUIRE(*value == i);
+            }
+        }
+
+        // Tombstones get reused or rehashed away
+        for (int round = 0; round < 10; ++round) {
+            for (int i = 0; i < 1000; i += 2) {
+                map[objects[i].get()] = round;
+            }
+            for (int i = 0; i < 1000; i += 2) {
+                map.Erase(objects[i].get());
+            }
+        }
+        REQUIRE(map.Size() == 500);
+        REQUIRE(map.Capacity() <= 2048);
+    }
+
+    SECTION("Interior pointer keys") {
+        // Neighbours differ only in the low bits, which the hash must keep
+        std::vector<int> array(64);
+        std::set<size_t> tags;
+        for (int& element : array) {
+            tags.insert(HashPointer(&element) & 0x7F);
+        }
+        REQUIRE(tags.size() > 32);
+
+        PointerHashMap<int*, int> map;
+        for (int i = 0; i < 64; ++i) {
+            map[&array[i]] = i;
+        }
+        for (int i = 0; i < 64; ++i) {
+            REQUIRE(*map.Find(&array[i]) == i);
+        }
+    }
+
+    SECTION("SharedPtr keys by owner") {
+        PointerHashMap<SharedPtr<MyInt>, int> map;
+        auto a = MakeShared<MyInt>(1);
+        auto b = MakeShared<MyInt>(2);
+        map[a] = 10;
+        map[b] = 20;
+        SharedPtr<MyInt> alias(a, b.Get());
+        REQUIRE(*map.Find(alias) == 10);
+        REQUIRE(a.UseCount() == 3);
+
+        size_t sum = 0;
+        map.ForEach([&sum](const SharedPtr<MyInt>&, int value) { sum += value; });
+        REQUIRE(sum == 30);
+
+        REQUIRE(map.EraseIf([](const SharedPtr<MyInt>&, int value) { return value == 10; }) == 1);
+        REQUIRE(a.UseCount() == 2);
+        map.Clear();
+        REQUIRE(b.UseCount() == 1);
+    }
+}
+
+TEST_CASE("CowPtr") {
+    CowPtr<std::vector<int>> document(std::in_place, 1000, 7);
+    auto snapshot = document;
+    REQUIRE(&*snapshot == &*document);
+    REQUIRE(document.UseCount() == 2);
+
+    document.Write()[0] = 1;
+    REQUIRE(snapshot->at(0) == 7);
+    REQUIRE(document->at(0) == 1);
+    REQUIRE(document.Unique());
+
+    // Unique: written in place
+    const int* data = document->data();
+    document.Write()[1] = 2;
+    REQUIRE(document->data() == data);
+}
+
+TEST_CASE("CowPtr across threads") {
+    using Policy = SharedPolicy<MultiThreaded, WeakSupport::kOff, SharedFromThisSupport::kOff>;
+    CowPtr<std::vector<int>, Policy> document(std::in_place, 100, 0);
+
+    std::atomic<int> mismatches = 0;
+    std::vector<std::thread> threads;
+    for (int i = 1; i <= 4; ++i) {
+        threads.emplace_back([snapshot = document, i, &mismatches]() mutable {
+            for (int j = 0; j < 100; ++j) {
+                snapshot.Write()[j] = i;
+            }
+            for (int value : *snapshot) {
+                mismatches += value != i;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(mismatches == 0);
+    REQUIRE(document.Unique());
+    REQUIRE(document->at(0) == 0);
+}
+
+TEST_CASE("SharedBuffer") {
+    SharedBuffer buffer;
+    EXPECT_ONE_ALLOCATION(buffer = SharedBuffer::Allocate(64));
+    for (size_t i = 0; i < buffer.Size(); ++i) {
+        buffer.Data()[i] = std::byte(i);
+    }
+
+    SharedBuffer slice;
+    EXPECT_ZERO_ALLOCATIONS(slice = buffer.Slice(10, 20));
+    REQUIRE(slice.Size() == 20);
+    REQUIRE(slice.Data()[0] == std::byte(10));
+    REQUIRE(buffer.UseCount() == 2);
+
+    // Outlives the original buffer
+    buffer = SharedBuffer();
+    SharedBuffer inner = slice.Slice(5, 5);
+    REQUIRE(inner.Data()[0] == std::byte(15));
+    REQUIRE(inner.UseCount() == 2);
+}
+
+TEST_CASE("ByteChain over a socket") {
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    std::string text = "header:payload-payload-payload";
+    auto message = SharedBuffer::Copy(std::as_bytes(std::span(text)));
+    ByteChain chain;
+    chain.Append(message.Slice(0, 7));
+    chain.Append(message.Slice(7, text.size() - 7));
+    chain.Append(message.Slice(0, 6));
+    REQUIRE(chain.Size() == text.size() + 6);
+
+    auto header = chain.Split(7);
+    REQUIRE(header.Size() == 7);
+    REQUIRE(chain.BufferCount() == 2);
+    header.Append(chain);
+
+    size_t total = header.Size();
+    while (!header.Empty()) {
+        REQUIRE(header.WriteTo(fds[0]) > 0);
+    }
+
+    ByteChain received;
+    while (received.Size() < total) {
+        REQUIRE(received.ReadFrom(fds[1], total - received.Size(), 8) > 0);
+    }
+    std::string out(total, '\0');
+    received.CopyTo(std::as_writable_bytes(std::span(out)));
+    REQUIRE(out == text + "header");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("ByteChain reads what is readable") {
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    REQUIRE(write(fds[0], "hello", 5) == 5);
+
+    // A megabyte may be read, but only the five readable bytes are allocated
+    ByteChain chain;
+    REQUIRE(chain.ReadFrom(fds[1], 1 << 20) == 5);
+    REQUIRE(chain.BufferCount() == 1);
+    std::string out(5, '\0');
+    chain.CopyTo(std::as_writable_bytes(std::span(out)));
+    REQUIRE(out == "hello");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("ByteChain appended to itself") {
+    auto message = SharedBuffer::Copy(std::as_bytes(std::span(std::string_view("abc"))));
+    ByteChain chain;
+    // Enough buffers for the deque to grow while appending
+    for (int i = 0; i < 600; ++i) {
+        chain.Append(message.Slice(i % 3, 1));
+    }
+    chain.Append(chain);
+    REQUIRE(chain.BufferCount() == 1200);
+    REQUIRE(chain.Size() == 1200);
+
+    std::string out(1200, '\0');
+    chain.CopyTo(std::as_writable_bytes(std::span(out)));
+    std::string expected;
+    for (int i = 0; i < 400; ++i) {
+        expected += "abc";
+    }
+    REQUIRE(out == expected);
+}
+
+TEST_CASE("MappedFile") {
+    char path[] = "/tmp/mapped_file_test_XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    std::string text;
+    for (int i = 0; i < 3000; ++i) {
+        text += "line " + std::to_string(i) + "\n";
+    }
+    REQUIRE(write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size()));
+    close(fd);
+
+    MappedSlice tail;
+    {
+        MappedFile file(path, {.advice = MappedFileAdvice::kSequential});
+        REQUIRE(file.Size() == text.size());
+        REQUIRE(file.All().View() == text);
+        tail = file.Slice(text.size() - 10, 10);
+    }
+    // The mapping lives as long as a slice does
+    REQUIRE(tail.View() == text.substr(text.size() - 10));
+    REQUIRE(tail.Slice(5, 5).View() == text.substr(text.size() - 5));
+
+    MappedFile streaming(path, {.streaming = true});
+    std::string joined;
+    streaming.ForEachWindow(5000, [&](size_t offset, MappedSlice window) {
+        REQUIRE(window.View() == std::string_view(text).substr(offset, window.Size()));
+        joined += window.View();
+    });
+    REQUIRE(joined == text);
+
+    MappedFile aligned(path, {.huge_page_aligned = true});
+    REQUIRE(reinterpret_cast<uintptr_t>(aligned.All().Data()) % (2 << 20) == 0);
+    REQUIRE(aligned.All().View() == text);
+
+    unlink(path);
+    REQUIRE_THROWS_AS(MappedFile(path), std::system_error);
+}
+
+TEST_CASE("SharedPtrVector") {
+    using Policy = SharedPolicy<OpCountingThreaded, WeakSupport::kOff, SharedFromThisSupport::kOff>;
+    auto first = MakeShared<std::string, Policy>("first");
+    auto second = MakeShared<std::string, Policy>("second");
+    RefcountOps::Reset();
+
+    // Fan-out of one pointer: a single increment
+    SharedPtrVector<std::string, Policy> vector(1000, first);
+    REQUIRE(first.UseCount() == 1001);
+    REQUIRE(RefcountOps::Total() == 1);
+
+    vector.PushBack(second);
+    vector.PushBack(nullptr);
+    vector.PushBack(std::move(second));
+    REQUIRE(!second);
+    REQUIRE(vector.Size() == 1003);
+    REQUIRE(vector[1000] == "second");
+    REQUIRE(vector.Get(1001) == nullptr);
+    REQUIRE(vector.Share(1002).UseCount() == 3);
+
+    size_t total = 0;
+    for (std::string* str : vector) {
+        total += str ? str->size() : 0;
+    }
+    REQUIRE(total == 1000 * 5 + 2 * 6);
+
+    // Runs: 1000 x first, second, empty, second
+    RefcountOps::Reset();
+    {
+        auto copy = vector;
+        REQUIRE(RefcountOps::increments == 3);
+        REQUIRE(first.UseCount() == 2001);
+    }
+    REQUIRE(RefcountOps::decrements == 3);
+    REQUIRE(first.UseCount() == 1001);
+
+    vector.PopBack();
+    REQUIRE(vector.Share(1000).UseCount() == 2);
+
+    SharedPtrVector<std::string, Policy> moved = std::move(vector);
+    REQUIRE(vector.Empty());
+    moved.Clear();
+    REQUIRE(first.UseCount() == 1);
+
+    // The vector may be the last owner, ASan checks the object is freed
+    {
+        SharedPtrVector<std::string, Policy> last(3, MakeShared<std::string, Policy>("gone"));
+        REQUIRE(last.Share(0).UseCount() == 4);
+    }
+}
+
+TEST_CASE("Bulk retain/release") {
+    using Policy = SharedPolicy<OpCountingThreaded, WeakSupport::kOff, SharedFromThisSupport::kOff>;
+    std::vector<SharedPtr<std::string, Policy>> objects;
+    for (int i = 0; i < 10; ++i) {
+        objects.push_back(MakeShared<std::string, Policy>(std::to_string(i)));
+    }
+    // Interleaved fan-out: equal blocks are never adjacent
+    std::vector<SharedPtr<std::string, Policy>> ptrs;
+    for (int i = 0; i < 1000; ++i) {
+        ptrs.push_back(objects[i % 10]);
+    }
+    ptrs.emplace_back();
+    RefcountOps::Reset();
+
+    auto copies = RetainAll(ptrs);
+    REQUIRE(copies.size() == 1001);
+    REQUIRE(*copies[13] == "3");
+    REQUIRE(!copies.back());
+    REQUIRE(objects[3].UseCount() == 201);
+    REQUIRE(RefcountOps::increments == 10);
+
+    ReleaseAll(copies);
+    REQUIRE(!copies[0]);
+    REQUIRE(objects[3].UseCount() == 101);
+    REQUIRE(RefcountOps::decrements == 10);
+
+    // The last owners go away together, every object is destroyed once (ASan)
+    objects.clear();
+    RefcountOps::Reset();
+    ReleaseAll(std::span<SharedPtr<std::string, Policy>>(ptrs).first(500));
+    ReleaseAll(ptrs);
+    REQUIRE(RefcountOps::decrements == 20);
+}
@@ -2,11 +2,15 @@
 
 #include "deleters.h"
 
+#include <common/function_deleter.h>
 #include <common/my_int.h>
 
 #include <catch.hpp>
+#include <cstdio>
+#include <string>
 #include <vector>
 #include <tuple>
+#include <type_traits>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -504,3 +508,74 @@ TEST_CASE("Compressed pair usage") {
          s2 = std::move(s);
      }
  }
+
+TEST_CASE("Relocatable") {
+    static_assert(std::is_nothrow_move_constructible_v<UniquePtr<int>>);
+    static_assert(kIsTriviallyRelocatable<UniquePtr<int>>);
+    static_assert(kIsTriviallyRelocatable<UniquePtr<int[]>>);
+    static_assert(!kIsTriviallyRelocatable<UniquePtr<int, Deleter<int>>>);
+}
+
+struct EmptyPolicy {};
+struct OtherEmptyPolicy {};
+struct FinalEmptyPolicy final {};
+
+TEST_CASE("CompressedTuple") {
+    static_assert(sizeof(CompressedTuple<int*, EmptyPolicy, OtherEmptyPolicy>) == sizeof(int*));
+    static_assert(sizeof(CompressedTuple<EmptyPolicy, int*, OtherEmptyPolicy>) == sizeof(int*));
+    static_assert(sizeof(CompressedTuple<int*, FinalEmptyPolicy>) ==
+                  sizeof(std::pair<int*, FinalEmptyPolicy>));
+    static_assert(sizeof(CompressedPair<int*, DefaultDeleter<int>>) == sizeof(int*));
+
+    SECTION("Values") {
+        CompressedTuple<int, EmptyPolicy, std::string> tuple(1, EmptyPolicy(), "abc");
+        REQUIRE(tuple.Get<0>() == 1);
+        REQUIRE(tuple.Get<2>() == "abc");
+        tuple.Get<0>() = 5;
+        auto copy = tuple;
+        REQUIRE(copy.Get<0>() == 5);
+        REQUIRE(copy.Get<2>() == "abc");
+    }
+
+    SECTION("Repeated empty types") {
+        CompressedPair<EmptyPolicy, EmptyPolicy> pair;
+        REQUIRE(static_cast<void*>(&pair.GetFirst()) != static_cast<void*>(&pair.GetSecond()));
+
+        CompressedTuple<EmptyPolicy, EmptyPolicy, EmptyPolicy> tuple;
+        REQUIRE(static_cast<void*>(&tuple.Get<0>()) != static_cast<void*>(&tuple.Get<2>()));
+    }
+
+    SECTION("Repeated stateful types") {
+        CompressedPair<std::string, std::string> pair("first", "second");
+        REQUIRE(pair.GetFirst() == "first");
+        REQUIRE(pair.GetSecond() == "second");
+    }
+}
+
+int freed_buffers = 0;
+
+void FreeBuffer(int* buffer) {
+    delete[] buffer;
+    ++freed_buffers;
+}
+
+TEST_CASE("FunctionDeleter") {
+    static_assert(sizeof(UniquePtr<FILE, FunctionDeleter<&fclose>>) == sizeof(FILE*));
+    static_assert(sizeof(UniquePtr<int, FunctionDeleter<&FreeBuffer>>) == sizeof(int*));
+
+    SECTION("C file") {
+        UniquePtr<FILE, FunctionDeleter<&fclose>> file(tmpfile());
+        REQUIRE(file);
+        REQUIRE(fputs("abc", file.Get()) >= 0);
+    }
+
+    SECTION("Called once") {
+        freed_buffers = 0;
+        {
+            UniquePtr<int, FunctionDeleter<&FreeBuffer>> buffer(new int[4]);
+            UniquePtr<int, FunctionDeleter<&FreeBuffer>> other = std::move(buffer);
+            REQUIRE(freed_buffers == 0);
+        }
+        REQUIRE(freed_buffers == 1);
+    }
+}
@@ -3,6 +3,8 @@
 #include "compressed_pair.h"
 #include "deleters.h"
 
+#include <common/relocation.h>
+
 #include <cstddef>  // std::nullptr_t
 #include <type_traits>
 
@@ -15,7 +17,7 @@ public:
     DefaultDeleter(const DefaultDeleter<K>&){};
 
     template <typename K>
-    DefaultDeleter(DefaultDeleter<K>&&){};
+    DefaultDeleter(DefaultDeleter<K>&&) noexcept {};
 
     template <typename K>
     DefaultDeleter& operator=(const DefaultDeleter<K>&) {
@@ -43,7 +45,7 @@ public:
     DefaultDeleter(const DefaultDeleter<K>&){};
 
     template <typename K>
-    DefaultDeleter(DefaultDeleter<K>&&){};
+    DefaultDeleter(DefaultDeleter<K>&&) noexcept {};
 
     template <typename K>
     DefaultDeleter& operator=(const DefaultDeleter<K>&) {
@@ -269,3 +271,8 @@ public:
 private:
     CompressedPair<T*, DeleterTemp> compressed_pair_;
 };
+
+// Relocatable as long as the deleter is
+template <typename T, typename DeleterTemp>
+inline constexpr bool kIsTriviallyRelocatable<UniquePtr<T, DeleterTemp>> =
+    kIsTriviallyRelocatable<DeleterTemp>;
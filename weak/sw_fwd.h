@@ -1,11 +1,13 @@
 #pragma once
 
-#include <exception>
+#include <common/shared_fwd.h>
 
-class BadWeakPtr : public std::exception {};
+// `WeakPtr` without `EnableSharedFromThis`
+using DefaultSharedPolicy = SharedPolicy<SingleThreaded, WeakSupport::kOn, SharedFromThisSupport::kOff>;
 
-template <typename T>
+template <typename T, typename Policy = DefaultSharedPolicy>
 class SharedPtr;
 
-template <typename T>
+template <typename T, typename Policy = DefaultSharedPolicy>
 class WeakPtr;
+
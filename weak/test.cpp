@@ -1,12 +1,26 @@
 #include "shared.h"
 #include "weak.h"
 
+#include <common/interner.h>
 #include <common/my_int.h>
+#include <common/observer_list.h>
+#include <common/op_counter.h>
+#include <common/pointer_hash_map.h>
+#include <common/slot_map.h>
+#include <common/weak_cache.h>
+#include <common/weak_ptr_set.h>
 
 #include <catch.hpp>
 
 #include "allocations_checker.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 TEST_CASE("Empty weak") {
@@ -174,4 +188,521 @@ TEST_CASE("Lifetimes") {
         }
         delete wp;
     }
-}
\ No newline at end of file
+}
+
+struct Header : TrailingArray<Header, MyInt> {};
+
+TEST_CASE("Weak to trailing object") {
+    WeakPtr<Header> weak;
+    {
+        auto shared = MakeSharedWithTrailing<Header, MyInt>(3);
+        weak = shared;
+        REQUIRE(MyInt::AliveCount() == 3);
+    }
+    REQUIRE(weak.Expired());
+    REQUIRE(MyInt::AliveCount() == 0);
+}
+
+struct alignas(16) Wide {
+    double a = 1;
+    double b = 2;
+};
+
+struct WideHeader : TrailingArray<WideHeader, Wide> {};
+
+TEST_CASE("Over-aligned trailing elements") {
+    // The weak counter moves the object off a 16-byte boundary unless the block realigns it
+    auto shared = MakeSharedWithTrailing<WideHeader, Wide>(3);
+    REQUIRE(reinterpret_cast<uintptr_t>(shared->Trailing().data()) % alignof(Wide) == 0);
+    REQUIRE(shared->Trailing()[2].b == 2);
+}
+
+struct Huge {
+    static void operator delete(void* ptr) {
+        freed = true;
+        ::operator delete(ptr);
+    }
+
+    char payload[1 << 16];
+
+    static bool freed;
+};
+
+bool Huge::freed = false;
+
+TEST_CASE("Weak does not pin huge objects") {
+    static_assert(sizeof(Huge) >= kMakeSharedSplitThreshold);
+    Huge::freed = false;
+    auto shared = MakeShared<Huge>();
+    WeakPtr<Huge> weak(shared);
+    shared.Reset();
+    REQUIRE(weak.Expired());
+    REQUIRE(Huge::freed);
+
+    EXPECT_ONE_ALLOCATION(auto small = MakeShared<int>(1));
+}
+
+TEST_CASE("MakeSharedLazyWeak") {
+    static_assert(sizeof(LazyWeakControlBlock<int>) < sizeof(ObjectControlBlock<int, DefaultSharedPolicy>));
+
+    SECTION("No side table without WeakPtr") {
+        SharedPtr<MyInt> a;
+        EXPECT_ONE_ALLOCATION(a = MakeSharedLazyWeak<MyInt>(7));
+        SharedPtr<MyInt> b = a;
+        REQUIRE(a.UseCount() == 2);
+        b.Reset();
+        REQUIRE(a.UseCount() == 1);
+        a.Reset();
+        REQUIRE(MyInt::AliveCount() == 0);
+    }
+
+    SECTION("Side table on first WeakPtr") {
+        auto a = MakeSharedLazyWeak<MyInt>(7);
+        auto b = a;
+        WeakPtr<MyInt> weak;
+        EXPECT_ONE_ALLOCATION(weak = a);
+        WeakPtr<MyInt> weak2;
+        EXPECT_ZERO_ALLOCATIONS(weak2 = weak);
+        REQUIRE(weak.UseCount() == 2);
+        REQUIRE(*weak.Lock() == 7);
+
+        a.Reset();
+        b.Reset();
+        REQUIRE(MyInt::AliveCount() == 0);
+        REQUIRE(weak.Expired());
+        REQUIRE(weak2.Lock().Get() == nullptr);
+    }
+}
+
+TEST_CASE("Weak to immortal object") {
+    static int answer = 42;
+    WeakPtr<int> weak;
+    {
+        auto shared = ImmortalShared(answer);
+        weak = shared;
+    }
+    REQUIRE(!weak.Expired());
+    REQUIRE(*weak.Lock() == 42);
+}
+
+TEST_CASE("Multithreaded policy") {
+    using Policy = SharedPolicy<MultiThreaded, WeakSupport::kOn, SharedFromThisSupport::kOff>;
+    auto shared = MakeShared<int, Policy>(5);
+    WeakPtr<int, Policy> weak = shared;
+
+    // Catch assertions are not thread-safe, count failures instead
+    std::atomic<int> mismatches = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([shared, &mismatches] {
+            for (int j = 0; j < 1000; ++j) {
+                SharedPtr<int, Policy> copy = shared;
+                WeakPtr<int, Policy> weak_copy = copy;
+                if (weak_copy.Lock().Get() != copy.Get()) {
+                    ++mismatches;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(mismatches == 0);
+    REQUIRE(shared.UseCount() == 1);
+    shared.Reset();
+    REQUIRE(weak.Expired());
+}
+
+struct Shape {
+    virtual ~Shape() = default;
+};
+
+struct Circle : Shape {
+    int radius = 2;
+};
+
+TEST_CASE("Rvalue paths skip refcount traffic") {
+    using Policy = SharedPolicy<OpCountingThreaded, WeakSupport::kOn, SharedFromThisSupport::kOff>;
+    SharedPtr<Shape, Policy> shape = MakeShared<Circle, Policy>();
+    RefcountOps::Reset();
+
+    SECTION("Casts and aliasing") {
+        auto circle = StaticPointerCast<Circle>(std::move(shape));
+        REQUIRE(!shape);
+        int* radius_ptr = &circle->radius;
+        SharedPtr<int, Policy> radius(std::move(circle), radius_ptr);
+        REQUIRE(*radius == 2);
+        REQUIRE(RefcountOps::Total() == 0);
+
+        auto copy = DynamicPointerCast<Circle>(SharedPtr<Shape, Policy>(radius, nullptr));
+        REQUIRE(!copy);
+        REQUIRE(RefcountOps::increments == 1);
+    }
+
+    SECTION("Consuming Lock") {
+        WeakPtr<Shape, Policy> weak = shape;
+        shape.Reset();
+        RefcountOps::Reset();
+        auto locked = std::move(weak).Lock();
+        REQUIRE(!locked);
+        REQUIRE(weak.UseCount() == 0);
+        // The failed strong increment is not an operation, dropping the last weak is
+        REQUIRE(RefcountOps::increments == 0);
+        REQUIRE(RefcountOps::decrements == 1);
+    }
+
+    SECTION("Consuming promotion") {
+        WeakPtr<Shape, Policy> weak = shape;
+        RefcountOps::Reset();
+        SharedPtr<Shape, Policy> promoted(std::move(weak));
+        REQUIRE(promoted.UseCount() == 2);
+        REQUIRE(weak.UseCount() == 0);
+        REQUIRE(RefcountOps::increments == 1);
+        REQUIRE(RefcountOps::decrements == 1);
+    }
+}
+
+TEST_CASE("WeakPtr keys") {
+    PointerHashMap<WeakPtr<int>, int> map;
+    auto a = MakeShared<int>(1);
+    auto b = MakeShared<int>(2);
+    map[a] = 1;
+    map[b] = 2;
+
+    REQUIRE(*map.Find(b) == 2);
+    b.Reset();
+    // An expired key keeps its owner, so it can still be found and erased
+    REQUIRE(map.EraseIf([](const WeakPtr<int>& key, int) { return key.Expired(); }) == 1);
+    REQUIRE(map.Size() == 1);
+    REQUIRE(map.Contains(a));
+}
+
+struct Expr {
+    int value;
+    HashConsed<Expr> child;
+
+    bool operator==(const Expr& other) const {
+        return value == other.value && child.Get() == other.child.Get();
+    }
+};
+
+struct ExprHash {
+    size_t operator()(const Expr& expr) const {
+        return std::hash<int>()(expr.value) ^ std::hash<const Expr*>()(expr.child.Get());
+    }
+};
+
+TEST_CASE("Interner") {
+    SECTION("Equal values share one object") {
+        Interner<std::string> interner;
+        auto a = interner.Intern(std::string("schema"));
+        auto b = interner.Intern(std::string("schema"));
+        auto c = interner.Intern(std::string("other"));
+        REQUIRE(a.Get() == b.Get());
+        REQUIRE(a.Get() != c.Get());
+        REQUIRE(a.UseCount() == 2);
+        REQUIRE(interner.Size() == 2);
+
+        a.Reset();
+        REQUIRE(interner.Size() == 2);
+        b.Reset();
+        REQUIRE(interner.Size() == 1);
+        auto d = interner.Intern(std::string("schema"));
+        REQUIRE(*d == "schema");
+        REQUIRE(interner.Size() == 2);
+    }
+
+    SECTION("Values outlive the interner") {
+        HashConsed<std::string> value;
+        {
+            Interner<std::string> interner;
+            value = interner.Intern(std::string("survivor"));
+        }
+        REQUIRE(*value == "survivor");
+    }
+
+    SECTION("Nested values") {
+        Interner<Expr, ExprHash> interner;
+        auto leaf = interner.Intern(Expr{1, nullptr});
+        auto root = interner.Intern(Expr{2, leaf});
+        auto same_root = interner.Intern(Expr{2, interner.Intern(Expr{1, nullptr})});
+        REQUIRE(root.Get() == same_root.Get());
+        leaf.Reset();
+        REQUIRE(interner.Size() == 2);
+        root.Reset();
+        same_root.Reset();
+        REQUIRE(interner.Size() == 0);
+    }
+}
+
+TEST_CASE("WeakCache") {
+    SECTION("Demoted values are resurrected while alive") {
+        WeakCache<int, std::string> cache(2 * sizeof(std::string), 1);
+        auto held = MakeShared<std::string>("held");
+        cache.Put(1, held);
+        cache.Put(2, MakeShared<std::string>("two"));
+        cache.Put(3, MakeShared<std::string>("three"));
+        REQUIRE(cache.StrongSize() == 2);
+        REQUIRE(cache.MemoryUsage() == 2 * sizeof(std::string));
+
+        // 1 was evicted but someone still holds it
+        auto found = cache.Get(1);
+        REQUIRE(found.Get() == held.Get());
+        // 2 was evicted by the resurrection of 1 and nobody holds it
+        REQUIRE(!cache.Get(2));
+        REQUIRE(*cache.Get(3) == "three");
+
+        WeakCacheStats stats = cache.Stats();
+        REQUIRE(stats.hits == 1);
+        REQUIRE(stats.resurrections == 1);
+        REQUIRE(stats.misses == 1);
+    }
+
+    SECTION("GetOrLoad") {
+        WeakCache<int, int> cache(1024);
+        int loads = 0;
+        auto loader = [&loads] {
+            ++loads;
+            return MakeShared<int>(42);
+        };
+        REQUIRE(*cache.GetOrLoad(7, loader) == 42);
+        REQUIRE(*cache.GetOrLoad(7, loader) == 42);
+        REQUIRE(loads == 1);
+        REQUIRE(cache.Erase(7));
+        REQUIRE(!cache.Get(7));
+    }
+
+    SECTION("Zero shards mean one") {
+        WeakCache<int, int> cache(1024, 0);
+        cache.Put(1, MakeShared<int>(1));
+        REQUIRE(*cache.Get(1) == 1);
+    }
+
+    SECTION("Shards on several threads") {
+        using Policy = SharedPolicy<MultiThreaded, WeakSupport::kOn, SharedFromThisSupport::kOff>;
+        WeakCache<int, int, Policy> cache(64 * sizeof(int), 4);
+        std::atomic<int> mismatches = 0;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&cache, &mismatches] {
+                for (int i = 0; i < 2000; ++i) {
+                    int key = i % 100;
+                    auto value = cache.GetOrLoad(key, [key] { return MakeShared<int, Policy>(key); });
+                    if (*value != key) {
+                        ++mismatches;
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        REQUIRE(mismatches == 0);
+        REQUIRE(cache.MemoryUsage() <= 64 * sizeof(int));
+    }
+}
+
+TEST_CASE("Expiry hooks") {
+    using Policy = SharedPolicy<SingleThreaded, WeakSupport::kOn, SharedFromThisSupport::kOff,
+                                ExpiryHookSupport::kOn>;
+    static_assert(sizeof(ObjectControlBlock<int, Policy>) >
+                  sizeof(ObjectControlBlock<int, DefaultSharedPolicy>));
+
+    auto shared = MakeShared<std::string, Policy>("value");
+    WeakPtr<std::string, Policy> weak = shared;
+    std::vector<int> fired;
+    REQUIRE(weak.OnExpire([&] { fired.push_back(1); }));
+    REQUIRE(weak.OnExpire([&] {
+        REQUIRE(!weak.Lock());
+        fired.push_back(2);
+    }));
+
+    auto copy = shared;
+    shared.Reset();
+    REQUIRE(fired.empty());
+    copy.Reset();
+    REQUIRE(fired == std::vector<int>{2, 1});
+
+    // Too late to register: runs right away
+    REQUIRE(!weak.OnExpire([&] { fired.push_back(3); }));
+    REQUIRE(fired == std::vector<int>{2, 1, 3});
+}
+
+TEST_CASE("Expiry hooks race with the last release") {
+    using Policy = SharedPolicy<MultiThreaded, WeakSupport::kOn, SharedFromThisSupport::kOff,
+                                ExpiryHookSupport::kOn>;
+    for (int round = 0; round < 100; ++round) {
+        auto shared = MakeShared<int, Policy>(round);
+        WeakPtr<int, Policy> weak = shared;
+        std::atomic<int> fired = 0;
+        std::thread registrar([weak, &fired] {
+            for (int i = 0; i < 10; ++i) {
+                weak.OnExpire([&fired] { ++fired; });
+            }
+        });
+        shared.Reset();
+        registrar.join();
+        // Every hook runs exactly once, either on release or on registration
+        REQUIRE(fired == 10);
+    }
+}
+
+TEST_CASE("ObserverList") {
+    struct Listener {
+        int id;
+        std::vector<int>* log;
+    };
+    std::vector<int> log;
+    std::vector<SharedPtr<Listener>> listeners;
+    ObserverList<Listener> list;
+    for (int i = 0; i < 100; ++i) {
+        listeners.push_back(MakeShared<Listener>(Listener{i, &log}));
+        list.Add(listeners.back());
+    }
+    list.Add(WeakPtr<Listener>());
+    REQUIRE(list.Size() == 100);
+
+    // Every third listener dies; the rest are called in order
+    for (int i = 0; i < 100; i += 3) {
+        listeners[i].Reset();
+    }
+    REQUIRE(list.Dispatch([](Listener& listener) { listener.log->push_back(listener.id); }) == 66);
+    REQUIRE(log.size() == 66);
+    REQUIRE(std::is_sorted(log.begin(), log.end()));
+    REQUIRE(list.Size() == 66);
+
+    // Added from a callback: called from the next dispatch on
+    auto late = MakeShared<Listener>(Listener{-1, &log});
+    bool added = false;
+    REQUIRE(list.Dispatch([&](Listener&) {
+        if (!added) {
+            list.Add(late);
+            added = true;
+        }
+    }) == 66);
+    REQUIRE(list.Size() == 67);
+    REQUIRE(list.Remove(late));
+    REQUIRE(!list.Remove(late));
+
+    // Nested dispatch from a callback in the second batch: sees every live listener once,
+    // although the outer one has already compacted the first batch
+    for (int i = 1; i < 100; i += 3) {
+        listeners[i].Reset();
+    }
+    size_t outer = 0;
+    size_t nested = 0;
+    REQUIRE(list.Dispatch([&](Listener&) {
+        if (++outer == 20) {
+            nested = list.Dispatch([](Listener&) {});
+        }
+    }) == 33);
+    REQUIRE(nested == 33);
+    REQUIRE(list.Size() == 33);
+
+    // Without dispatches dead entries are dropped by `Add`
+    listeners.clear();
+    for (int i = 0; i < 200; ++i) {
+        list.Add(MakeShared<Listener>(Listener{i, &log}));
+    }
+    REQUIRE(list.Size() < 100);
+    REQUIRE(list.Dispatch([](Listener&) {}) == 0);
+    REQUIRE(list.Empty());
+}
+
+TEST_CASE("WeakPtrSet") {
+    std::vector<SharedPtr<int>> owners;
+    WeakPtrSet<int> set;
+    for (int i = 0; i < 1000; ++i) {
+        owners.push_back(MakeShared<int>(i));
+        set.Insert(owners.back());
+    }
+    set.Insert(WeakPtr<int>());
+    set.Insert(owners[1]);
+    REQUIRE(set.Size() == 1001);
+
+    // Every other object dies; locking skips them, sweeping drops them
+    for (int i = 0; i < 1000; i += 2) {
+        owners[i].Reset();
+    }
+    auto locked = set.LockAll();
+    REQUIRE(locked.size() == 501);
+    REQUIRE(*locked[0] == 1);
+    REQUIRE(owners[1].UseCount() == 3);
+    REQUIRE(set.Size() == 1001);
+
+    REQUIRE(set.SweepExpired() == 500);
+    REQUIRE(set.Size() == 501);
+    REQUIRE(set.SweepExpired() == 0);
+
+    // Both entries of one owner go at once
+    REQUIRE(set.Erase(owners[1]) == 2);
+    REQUIRE(set.Erase(owners[1]) == 0);
+
+    locked.clear();
+    owners.clear();
+    REQUIRE(set.LockAll().empty());
+    REQUIRE(set.SweepExpired() == 499);
+    REQUIRE(set.Empty());
+}
+
+TEST_CASE("SlotMap") {
+    SlotMap<std::string> map;
+    auto a = map.Insert("a");
+    auto b = map.Emplace(3, 'b');
+    auto c = map.Insert("c");
+    REQUIRE(map.Size() == 3);
+    REQUIRE(*map.Find(b) == "bbb");
+    REQUIRE(!map.Contains(SlotHandle()));
+    REQUIRE(SlotHandle::FromBits(b.Bits()) == b);
+
+    // The last value moves into the hole, handles stay valid
+    REQUIRE(map.Erase(a));
+    REQUIRE(!map.Erase(a));
+    REQUIRE(map.Find(a) == nullptr);
+    REQUIRE(*map.Find(c) == "c");
+    REQUIRE(map.Values().size() == 2);
+
+    // The freed slot is reused with a new generation
+    auto d = map.Insert("d");
+    REQUIRE(d.index == a.index);
+    REQUIRE(!map.Contains(a));
+    REQUIRE(*map.Find(d) == "d");
+
+    std::vector<std::string> seen;
+    map.ForEach([&](SlotHandle handle, std::string& value) {
+        REQUIRE(map.Find(handle) == &value);
+        seen.push_back(value);
+    });
+    std::sort(seen.begin(), seen.end());
+    REQUIRE(seen == std::vector<std::string>{"bbb", "c", "d"});
+
+    {
+        auto borrow = map.Lock(c);
+        REQUIRE(borrow);
+        REQUIRE(*borrow == "c");
+        REQUIRE_THROWS_AS(map.Erase(c), SlotMapBorrowed);
+        REQUIRE_THROWS_AS(map.Insert("e"), SlotMapBorrowed);
+        REQUIRE(!map.Lock(a));
+    }
+    REQUIRE(map.Erase(c));
+
+    map.Clear();
+    REQUIRE(map.Empty());
+    REQUIRE(!map.Contains(b));
+    REQUIRE(!map.Contains(d));
+    auto e = map.Insert("e");
+    REQUIRE(*map.Find(e) == "e");
+    REQUIRE(map.Size() == 1);
+
+    // A throwing constructor leaves the map as it was, with a fresh and with a reused slot
+    REQUIRE_THROWS_AS(map.Emplace(std::string::npos, 'x'), std::length_error);
+    REQUIRE(map.Size() == 1);
+    REQUIRE(map.Erase(e));
+    REQUIRE_THROWS_AS(map.Emplace(std::string::npos, 'x'), std::length_error);
+    auto f = map.Insert("f");
+    REQUIRE(f.index == e.index);
+    REQUIRE(!map.Contains(e));
+    REQUIRE(map.Values().size() == 1);
+    REQUIRE(map.Erase(f));
+    REQUIRE(map.Empty());
+}